@@ -1,28 +1,52 @@
 #ifndef AVLTree_H
 #define AVLTree_H
 #include <iostream>
+#include <queue>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <limits>
 #include "AVL_Node.h"
 #include "AVL_Iterator.h"
+#include "AVL_Allocator.h"
+#include "AVL_SortedRun.h"
+#include "ThreadPool.h"
+#include "Stats.h"
 
 using namespace std;
 
-template<typename T, typename Node = NodeAVL<T> >
+template<typename T, typename Node = NodeAVL<T>, typename Alloc = NodeArena<Node>, typename Stats = NoStats>
 class AVLTree {
 
     Node *root;
-    int nodes;
+    Alloc alloc;
+    // empty and free with NoStats, see Stats.h
+    [[no_unique_address]] Stats stats;
 
 public:
-    typedef AVLIterator<T> iterator;
+    typedef AVLIterator<T, Node> iterator;
+
+    // below this many keys parallel operations run the serial code
+    static const int ParallelGrain = 4096;
 
     Node* getRoot() const { return root; }
 
-    iterator begin(AVLIterator<int>::Type type) {
+    iterator begin(typename iterator::Type type = iterator::InOrder) {
         return iterator(root, type);
     }
 
     iterator end() {
-        return iterator(nullptr);
+        return iterator(root, iterator::InOrder, true);
+    }
+
+    iterator rbegin() {
+        return iterator(root, iterator::ReverseInOrder);
+    }
+
+    iterator rend() {
+        return iterator(root, iterator::ReverseInOrder, true);
     }
 
     static T minValue(Node* node) {
@@ -41,73 +65,293 @@ public:
         return node->data;
     }
 
-    Node *_insert(Node *n, T value) {
-        if (!n) {
-            return new Node(value);
+    // Deeper than any AVL tree of fewer than 2^31 keys (1.44 log2(n + 2))
+    static constexpr int MaxHeight = 64;
+
+    // Walks down recording the path, links the new leaf and walks back up.
+    // Sizes change along the whole path, heights only until a subtree keeps
+    // its height; a rotation after an insert restores the old height, so it
+    // also ends the rebalancing. A duplicate returns before touching anything.
+    bool _insert(const T& value) {
+        Node* path[MaxHeight];
+        int depth = 0;
+        Node* n = root;
+        while (n) {
+            path[depth++] = n;
+            if (n->data == value) return false; // valor duplicado
+            n = value < n->data ? n->left : n->right;
         }
 
-        if (value < n->data) {
-            n->left = _insert(n->left, value);
-        } else if (value > n->data) {
-            n->right = _insert(n->right, value);
-        } else {
-            return n; // valor duplicado
+        Node* leaf = alloc.create(value);
+        if (depth == 0) {
+            root = leaf;
+            return true;
         }
+        Node* parent = path[depth - 1];
+        if (value < parent->data) parent->left = leaf;
+        else parent->right = leaf;
 
-        updateHeight(n);
-        return balance(n);
+        _rebalance_path(path, depth, 1);
+        return true;
     }
 
-    Node* _remove(Node* node, T value) {
-        if (!node) return nullptr;
+    // Same path walk as _insert. A node with two children takes its
+    // predecessor's key and the predecessor, which has no right child, is
+    // unlinked instead. After a removal a rotation can still lower the
+    // subtree, so only an unchanged height ends the rebalancing.
+    bool _remove(const T& value) {
+        Node* path[MaxHeight];
+        int depth = 0;
+        Node* n = root;
+        while (n && !(n->data == value)) {
+            path[depth++] = n;
+            n = value < n->data ? n->left : n->right;
+        }
+        if (!n) return false;
+
+        if (n->left && n->right) {
+            path[depth++] = n;
+            Node* predecessor = n->left;
+            while (predecessor->right) {
+                path[depth++] = predecessor;
+                predecessor = predecessor->right;
+            }
+            n->data = std::move(predecessor->data);
+            n = predecessor;
+        }
+        _relink(path, depth, n, n->left ? n->left : n->right);
+        alloc.destroy(n);
 
-        if (value < node->data) {
-            node->left = _remove(node->left, value);
-        } else if (value > node->data) {
-            node->right = _remove(node->right, value);
+        _rebalance_path(path, depth, -1);
+        return true;
+    }
+
+    // Rebalances path[0..depth) bottom-up after a leaf gained or lost a node,
+    // then adds delta to the sizes above the first subtree whose height held
+    void _rebalance_path(Node** path, int depth, int delta) {
+        while (depth > 0) {
+            Node* n = path[--depth];
+            int old_height = n->height;
+            Node* top = n;
+            balance(top);
+            _relink(path, depth, n, top);
+            if (top->height == old_height) break;
+        }
+        while (depth > 0) path[--depth]->size += delta;
+    }
+
+    // Points whatever held child (the parent at path[depth - 1], or root) to replacement
+    void _relink(Node** path, int depth, Node* child, Node* replacement) {
+        if (child == replacement) return;
+        if (depth == 0) {
+            root = replacement;
+        } else if (path[depth - 1]->left == child) {
+            path[depth - 1]->left = replacement;
         } else {
-            if (!node->left || !node->right) {
-                // Case 1: 0 or 1 child
-                Node* temp = node->left ? node->left : node->right;
-                delete node;
-                return temp;
-            } else { //
-                // Case 2: 2 children -> Se trabaja con el predecesor en este caso
-                Node* predecessor = node->left;
-                while (predecessor->right) {
-                    predecessor = predecessor->right;
-                }
-                node->data = predecessor->data;
-                node->left = _remove(node->left, predecessor->data);
+            path[depth - 1]->right = replacement;
+        }
+    }
+
+    AVLTree() : root(nullptr) {
+    }
+
+    AVLTree(const AVLTree&) = delete;
+    AVLTree& operator=(const AVLTree&) = delete;
+
+    AVLTree(AVLTree&& other) noexcept : root(other.root), alloc(std::move(other.alloc)), stats(other.stats) {
+        other.root = nullptr;
+    }
+
+    AVLTree& operator=(AVLTree&& other) noexcept {
+        if (this != &other) {
+            alloc.release(root);
+            root = other.root;
+            alloc = std::move(other.alloc);
+            stats = other.stats;
+            other.root = nullptr;
+        }
+        return *this;
+    }
+
+    // Builds a perfectly balanced tree from strictly increasing keys in O(n)
+    template<typename It>
+    static AVLTree from_sorted(It first, It last) {
+        int n = 0;
+        It prev = first;
+        for (It it = first; it != last; ++it) {
+            if (n++ > 0 && !(*prev < *it)) {
+                throw invalid_argument("from_sorted expects strictly increasing keys");
             }
+            prev = it;
         }
+        AVLTree tree;
+        tree.root = tree._build(tree.alloc, first, n);
+        return tree;
+    }
 
-        // Update height and balance
-        updateHeight(node);
-        return balance(node);
+    // Writes the keys to fd as a sorted run (AVL_SortedRun.h): one in-order
+    // pass, compressed block by block, with memory bounded by one block. With
+    // index, the run ends in a sparse index of block first keys that
+    // sorted_run_contains can search without reading the whole file.
+    void save(int fd, bool index = false) {
+        SortedRunWriter<T> writer(fd, size(), index);
+        _inorder(root, [&](Node* node) {
+            writer.append(node->data);
+        });
+        writer.finish();
     }
 
+    // Rebuilds a tree written by save() in O(n), building bottom-up as the
+    // keys stream in from fd, so a pipe or socket works too and only one
+    // block is buffered. Throws runtime_error on a malformed run; the build
+    // stops at the first bad block, so a run can never make load allocate
+    // more nodes than it holds keys.
+    static AVLTree load(int fd) {
+        SortedRunReader<T> reader(fd);
+        if (reader.size() > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+            throw runtime_error("Sorted run too large for AVLTree");
+        }
+        AVLTree tree;
+        auto keys = reader.keys();
+        tree.root = tree._build_run(tree.alloc, keys, static_cast<int>(reader.size()));
+        // what was built before the error is still linked under root and is dropped here
+        if (reader.failed()) throw runtime_error(reader.error());
+        return tree;
+    }
+
+    // Appends every key of greater, which must all be above our keys.
+    // O(log n) plus handing greater's storage over to this tree.
+    void join(AVLTree& greater) {
+        if (!greater.root) return;
+        if (root && !(maxValue(root) < minValue(greater.root))) {
+            throw invalid_argument("join expects every key of the right tree to be greater");
+        }
+        alloc.absorb(greater.alloc);
+        Node* right = greater.root;
+        greater.root = nullptr;
+        root = _join2(root, right);
+    }
 
-    AVLTree() : root(nullptr), nodes(0) {
+    // Keeps the keys below value and moves the keys above it into greater,
+    // replacing its contents. Returns whether value was present.
+    // O(log n) plus clearing greater: the upper nodes stay where they are and
+    // greater's allocator shares this tree's storage (NodeArena::share).
+    bool split(const T& value, AVLTree& greater) {
+        greater.clear();
+        Node *l, *r;
+        Node* mid = _split(root, value, l, r);
+        if (mid) alloc.destroy(mid);
+        root = l;
+        alloc.share(greater.alloc);
+        greater.root = r;
+        return mid != nullptr;
     }
 
-    void insert(T value) {
-        root = _insert(root, value);
-        ++nodes;
+    // Set algebra through split/join, O(m log(n/m + 1)) for sizes m <= n.
+    // Keys that only other holds are copied into this tree.
+    void set_union(const AVLTree& other) {
+        if (&other == this) return;
+        root = _union(alloc, root, other.root);
+    }
+
+    void set_intersection(const AVLTree& other) {
+        if (&other == this) return;
+        root = _intersection(alloc, root, other.root);
+    }
+
+    void set_difference(const AVLTree& other) {
+        if (&other == this) {
+            clear();
+            return;
+        }
+        root = _difference(alloc, root, other.root);
+    }
+
+    template<typename It>
+    void insert_many(It first, It last) {
+        AVLTree keys = _sorted_keys(first, last, nullptr, ParallelGrain);
+        set_union(keys);
+    }
+
+    template<typename It>
+    void remove_many(It first, It last) {
+        AVLTree keys = _sorted_keys(first, last, nullptr, ParallelGrain);
+        set_difference(keys);
+    }
+
+    // Parallel variants. They fork on pool while a subproblem has more than
+    // grain keys and use the serial code below that. Each forked branch
+    // allocates from its own allocator, which is absorbed into the parent's
+    // once the branch has joined, so no allocator is shared between threads.
+    // A grain below 1 is taken as 1.
+
+    // from_sorted with a random access range
+    template<typename It>
+    static AVLTree from_sorted(It first, It last, WorkStealingPool& pool, int grain = ParallelGrain) {
+        grain = std::max(grain, 1);
+        AVLTree tree;
+        std::atomic<bool> unsorted(false);
+        int n = static_cast<int>(last - first);
+        pool.run([&] {
+            tree.root = tree._par_build(tree.alloc, first, n, pool, grain, unsorted);
+        });
+        if (unsorted.load()) {
+            tree.clear();
+            throw invalid_argument("from_sorted expects strictly increasing keys");
+        }
+        return tree;
     }
 
-    bool find(T value) {
+    void set_union(const AVLTree& other, WorkStealingPool& pool, int grain = ParallelGrain) {
+        if (&other == this) return;
+        grain = std::max(grain, 1);
+        pool.run([&] { root = _par_union(alloc, root, other.root, pool, grain); });
+    }
+
+    void set_intersection(const AVLTree& other, WorkStealingPool& pool, int grain = ParallelGrain) {
+        if (&other == this) return;
+        grain = std::max(grain, 1);
+        pool.run([&] { root = _par_intersection(alloc, root, other.root, pool, grain); });
+    }
+
+    void set_difference(const AVLTree& other, WorkStealingPool& pool, int grain = ParallelGrain) {
+        if (&other == this) {
+            clear();
+            return;
+        }
+        grain = std::max(grain, 1);
+        pool.run([&] { root = _par_difference(alloc, root, other.root, pool, grain); });
+    }
+
+    template<typename It>
+    void insert_many(It first, It last, WorkStealingPool& pool, int grain = ParallelGrain) {
+        grain = std::max(grain, 1);
+        AVLTree keys = _sorted_keys(first, last, &pool, grain);
+        set_union(keys, pool, grain);
+    }
+
+    template<typename It>
+    void remove_many(It first, It last, WorkStealingPool& pool, int grain = ParallelGrain) {
+        grain = std::max(grain, 1);
+        AVLTree keys = _sorted_keys(first, last, &pool, grain);
+        set_difference(keys, pool, grain);
+    }
+
+    void insert(const T& value) {
+        auto timer = stats.time(StatOp::Insert);
+        _insert(value);
+    }
+
+    bool find(const T& value) {
+        auto timer = stats.time(StatOp::Find);
         Node *curr = root;
         while (curr != nullptr) {
-            auto data = curr->data;
+            const T& data = curr->data;
             if (data == value) {
                 return true;
             }
-            if (data > value) {
-                curr = curr->left;
-            } else {
-                curr = curr->right;
-            }
+            // a select rather than a branch, which random keys would mispredict
+            curr = value < data ? curr->left : curr->right;
         }
         return false;
     }
@@ -162,66 +406,149 @@ public:
     }
 
 
-    static int size() {
-        return 0;
+    [[nodiscard]] int size() const {
+        return size_of(root);
+    }
+
+    // First key not less than value
+    iterator lower_bound(const T& value) {
+        return iterator::first_where(root, [&](const T& data) { return !(data < value); });
+    }
+
+    // First key greater than value
+    iterator upper_bound(const T& value) {
+        return iterator::first_where(root, [&](const T& data) { return value < data; });
     }
 
-    void remove(T value) {
-        root = _remove(root, value);
-        --nodes;
+    pair<iterator, iterator> equal_range(const T& value) {
+        return {lower_bound(value), upper_bound(value)};
     }
 
+    // Calls fn on every key in [lo, hi] in order, visiting only the
+    // O(log n + k) nodes whose subtrees can intersect the range
+    template<typename Fun>
+    void for_each_in_range(const T& lo, const T& hi, Fun fn) const {
+        if (hi < lo) return;
+        _range(root, lo, hi, fn);
+    }
 
-    T successor(T value) {
+    // Answers `count` ranges in one descent. Ranges must be sorted and
+    // disjoint; fn(i, key) receives the index of the matching range, and the
+    // keys arrive in ascending order.
+    template<typename Fun>
+    void for_each_in_ranges(const pair<T, T>* ranges, int count, Fun fn) const {
+        _ranges(root, ranges, 0, count, fn);
+    }
+
+    // Number of keys strictly less than value
+    int rank(const T& value) const {
+        int r = 0;
         Node *curr = root;
-        T last_val;
-        bool found = false;
         while (curr != nullptr) {
-            auto data = curr->data;
-            if (data > value) {
-                last_val = data;
-                found = true;
+            if (curr->data < value) {
+                r += size_of(curr->left) + 1;
+                curr = curr->right;
+            } else {
+                curr = curr->left;
+            }
+        }
+        return r;
+    }
+
+    // k-th smallest key, 0-based
+    const T& select(int k) const {
+        if (k < 0 || k >= size()) {
+            throw out_of_range("Select index " + to_string(k) + " out of range");
+        }
+        Node *curr = root;
+        while (true) {
+            int left = size_of(curr->left);
+            if (k < left) {
+                curr = curr->left;
+            } else if (k > left) {
+                k -= left + 1;
+                curr = curr->right;
+            } else {
+                return curr->data;
+            }
+        }
+    }
+
+    // Number of keys in [lo, hi]
+    int count_range(const T& lo, const T& hi) const {
+        if (hi < lo) return 0;
+        return count_not_greater(hi) - rank(lo);
+    }
+
+    // Nearest-rank percentile, p in [0, 100]
+    const T& percentile(double p) const {
+        if (!root) throw runtime_error("Cannot get percentile of an empty tree");
+        if (p < 0 || p > 100) {
+            throw invalid_argument("Percentile must be in [0, 100]");
+        }
+        int n = size();
+        int k = static_cast<int>(std::ceil(p / 100.0 * n)) - 1;
+        return select(std::max(k, 0));
+    }
+
+    void remove(const T& value) {
+        auto timer = stats.time(StatOp::Remove);
+        _remove(value);
+    }
+
+    // Counters of the Stats policy (Stats.h): rotations by case, latency of
+    // insert/find/remove and, sampled now, the height against log2(n)
+    const Stats& getStats() {
+        stats.shape(height(), size());
+        return stats;
+    }
+
+    void resetStats() {
+        stats = Stats();
+    }
+
+
+    T successor(const T& value) {
+        const Node *curr = root;
+        const Node *best = nullptr;
+        while (curr != nullptr) {
+            if (value < curr->data) {
+                best = curr;
                 curr = curr->left;
             } else {
                 curr = curr->right;
             }
         }
 
-        if (!found) {
+        if (!best) {
             throw invalid_argument("No successor for " + to_string(value) + " value");
         }
 
-        return last_val;
+        return best->data;
     }
 
-    T predecessor(T value) {
-        Node *curr = root;
-        T last_val;
-        bool found = false;
+    T predecessor(const T& value) {
+        const Node *curr = root;
+        const Node *best = nullptr;
         while (curr != nullptr) {
-            auto data = curr->data;
-            if (data < value) {
-                last_val = data;
-                found = true;
+            if (curr->data < value) {
+                best = curr;
                 curr = curr->right;
             } else {
                 curr = curr->left;
             }
         }
 
-        if (!found) {
+        if (!best) {
             throw invalid_argument("No predecessor for " + to_string(value) + " value");
         }
 
-        return last_val;
+        return best->data;
     }
 
     void clear() {
-        if (this->root != nullptr) {
-            this->root->killSelf();
-            this->root = nullptr;
-            this->nodes = 0;
-        }
+        alloc.release(this->root);
+        this->root = nullptr;
     }
 
     void displayPretty() {
@@ -230,41 +557,362 @@ public:
 
 
     ~AVLTree() {
-        if (this->root != nullptr) {
-            this->root->killSelf();
-        }
+        alloc.release(this->root);
     }
 
-    static int height_of(Node *n) {
+    static int height_of(const Node *n) {
         return n ? n->height : -1;
     }
 
+    static int size_of(const Node *n) {
+        return n ? n->size : 0;
+    }
+
 private:
     template<typename Fun>
-    void _preorder(Node *node, Fun func) {
+    void _range(Node *node, const T& lo, const T& hi, Fun& fn) const {
         if (!node) return;
 
-        func(node);
-        _preorder(node->left, func);
-        _preorder(node->right, func);
+        bool above_lo = lo < node->data;
+        bool below_hi = node->data < hi;
+        if (above_lo) _range(node->left, lo, hi, fn);
+        if (!(node->data < lo) && !(hi < node->data)) fn(node->data);
+        if (below_hi) _range(node->right, lo, hi, fn);
+    }
+
+    template<typename It>
+    Node* _build(Alloc& a, It& it, int n) {
+        if (n == 0) return nullptr;
+        Node* left = _build(a, it, n / 2);
+        Node* node = a.create(*it);
+        ++it;
+        node->left = left;
+        node->right = _build(a, it, n - n / 2 - 1);
+        update(node);
+        return node;
+    }
+
+    // _build over a sorted run: once the reader fails no more nodes are made,
+    // and the subtrees already built stay linked so the tree can free them
+    Node* _build_run(Alloc& a, typename SortedRunReader<T>::cursor& it, int n) {
+        if (n == 0 || it.failed()) return nullptr;
+        Node* left = _build_run(a, it, n / 2);
+        if (it.failed()) return left;
+        Node* node = a.create(*it);
+        ++it;
+        node->left = left;
+        node->right = _build_run(a, it, n - n / 2 - 1);
+        update(node);
+        return node;
+    }
+
+    Node* _copy(Alloc& a, const Node* n) {
+        if (!n) return nullptr;
+        Node* c = a.create(n->data);
+        c->left = _copy(a, n->left);
+        c->right = _copy(a, n->right);
+        update(c);
+        return c;
+    }
+
+    // Frees a detached subtree without recursion by flattening it into a vine
+    void _destroy(Alloc& a, Node* n) {
+        while (n) {
+            if (n->left) {
+                Node* l = n->left;
+                n->left = l->right;
+                l->right = n;
+                n = l;
+            } else {
+                Node* next = n->right;
+                a.destroy(n);
+                n = next;
+            }
+        }
+    }
+
+    // Joins l < k < r. The taller side is walked down its spine until the
+    // heights match, then rebalanced on the way back like an insertion.
+    Node* _join(Node* l, Node* k, Node* r) {
+        if (height_of(l) > height_of(r) + 1) {
+            l->right = _join(l->right, k, r);
+            update(l);
+            return balance(l);
+        }
+        if (height_of(r) > height_of(l) + 1) {
+            r->left = _join(l, k, r->left);
+            update(r);
+            return balance(r);
+        }
+        k->left = l;
+        k->right = r;
+        update(k);
+        return k;
+    }
+
+    // Detaches the largest node of n into last
+    Node* _split_last(Node* n, Node*& last) {
+        if (!n->right) {
+            last = n;
+            Node* l = n->left;
+            n->left = nullptr;
+            return l;
+        }
+        n->right = _split_last(n->right, last);
+        update(n);
+        return balance(n);
+    }
+
+    Node* _join2(Node* l, Node* r) {
+        if (!l) return r;
+        if (!r) return l;
+        Node* last;
+        l = _split_last(l, last);
+        return _join(l, last, r);
+    }
+
+    // Splits n into keys below and above value; returns the detached node
+    // holding value, or nullptr
+    Node* _split(Node* n, const T& value, Node*& l, Node*& r) {
+        if (!n) {
+            l = r = nullptr;
+            return nullptr;
+        }
+        Node* left = n->left;
+        Node* right = n->right;
+        if (value < n->data) {
+            Node* between;
+            Node* found = _split(left, value, l, between);
+            r = _join(between, n, right);
+            return found;
+        }
+        if (n->data < value) {
+            Node* between;
+            Node* found = _split(right, value, between, r);
+            l = _join(left, n, between);
+            return found;
+        }
+        l = left;
+        r = right;
+        n->left = n->right = nullptr;
+        return n;
+    }
+
+    Node* _union(Alloc& a, Node* mine, const Node* other) {
+        if (!other) return mine;
+        if (!mine) return _copy(a, other);
+        Node *l, *r;
+        Node* mid = _split(mine, other->data, l, r);
+        if (!mid) mid = a.create(other->data);
+        l = _union(a, l, other->left);
+        r = _union(a, r, other->right);
+        return _join(l, mid, r);
+    }
+
+    Node* _intersection(Alloc& a, Node* mine, const Node* other) {
+        if (!mine) return nullptr;
+        if (!other) {
+            _destroy(a, mine);
+            return nullptr;
+        }
+        Node *l, *r;
+        Node* mid = _split(mine, other->data, l, r);
+        l = _intersection(a, l, other->left);
+        r = _intersection(a, r, other->right);
+        return mid ? _join(l, mid, r) : _join2(l, r);
+    }
+
+    Node* _difference(Alloc& a, Node* mine, const Node* other) {
+        if (!mine) return nullptr;
+        if (!other) return mine;
+        Node *l, *r;
+        Node* mid = _split(mine, other->data, l, r);
+        if (mid) a.destroy(mid);
+        l = _difference(a, l, other->left);
+        r = _difference(a, r, other->right);
+        return _join2(l, r);
+    }
+
+    // Copies [first, last) into a sorted, duplicate-free tree of keys
+    template<typename It>
+    static AVLTree _sorted_keys(It first, It last, WorkStealingPool* pool, int grain) {
+        int n = static_cast<int>(std::distance(first, last));
+        std::unique_ptr<T[]> keys(new T[n]);
+        std::copy(first, last, keys.get());
+        if (pool) {
+            std::unique_ptr<T[]> tmp(new T[n]);
+            pool->run([&] { _par_sort(keys.get(), tmp.get(), n, *pool, grain); });
+        } else {
+            std::sort(keys.get(), keys.get() + n);
+        }
+        T* end = std::unique(keys.get(), keys.get() + n, [](const T& x, const T& y) {
+            return !(x < y) && !(y < x);
+        });
+        if (pool) return from_sorted(keys.get(), end, *pool, grain);
+        return from_sorted(keys.get(), end);
+    }
+
+    static void _par_sort(T* keys, T* tmp, int n, WorkStealingPool& pool, int grain) {
+        if (n <= grain) {
+            std::sort(keys, keys + n);
+            return;
+        }
+        int half = n / 2;
+        pool.fork_join([&] { _par_sort(keys, tmp, half, pool, grain); },
+                       [&] { _par_sort(keys + half, tmp + half, n - half, pool, grain); });
+        std::merge(keys, keys + half, keys + half, keys + n, tmp);
+        std::copy(tmp, tmp + n, keys);
+    }
+
+    // grain >= 1, so a range that forks always has a middle key
+    template<typename It>
+    Node* _par_build(Alloc& a, It first, int n, WorkStealingPool& pool, int grain, std::atomic<bool>& unsorted) {
+        if (n <= grain) {
+            for (int i = 1; i < n; ++i) {
+                if (!(first[i - 1] < first[i])) unsorted.store(true);
+            }
+            It it = first;
+            return _build(a, it, n);
+        }
+        int half = n / 2;
+        It mid = first + half;
+        Node *left, *right;
+        Alloc branch;
+        pool.fork_join([&] { left = _par_build(branch, first, half, pool, grain, unsorted); },
+                       [&] { right = _par_build(a, mid + 1, n - half - 1, pool, grain, unsorted); });
+        if (!(mid[-1] < mid[0]) || (n - half > 1 && !(mid[0] < mid[1]))) unsorted.store(true);
+        a.absorb(branch);
+        Node* node = a.create(*mid);
+        node->left = left;
+        node->right = right;
+        update(node);
+        return node;
+    }
+
+    Node* _par_copy(Alloc& a, const Node* n, WorkStealingPool& pool, int grain) {
+        if (size_of(n) <= grain) return _copy(a, n);
+        Node *left, *right;
+        Alloc branch;
+        pool.fork_join([&] { left = _par_copy(branch, n->left, pool, grain); },
+                       [&] { right = _par_copy(a, n->right, pool, grain); });
+        a.absorb(branch);
+        Node* c = a.create(n->data);
+        c->left = left;
+        c->right = right;
+        update(c);
+        return c;
     }
 
+    Node* _par_union(Alloc& a, Node* mine, const Node* other, WorkStealingPool& pool, int grain) {
+        if (size_of(mine) + size_of(other) <= grain) return _union(a, mine, other);
+        if (!other) return mine;
+        if (!mine) return _par_copy(a, other, pool, grain);
+        Node *l, *r;
+        Node* mid = _split(mine, other->data, l, r);
+        if (!mid) mid = a.create(other->data);
+        Alloc branch;
+        pool.fork_join([&] { l = _par_union(branch, l, other->left, pool, grain); },
+                       [&] { r = _par_union(a, r, other->right, pool, grain); });
+        a.absorb(branch);
+        return _join(l, mid, r);
+    }
+
+    Node* _par_intersection(Alloc& a, Node* mine, const Node* other, WorkStealingPool& pool, int grain) {
+        if (size_of(mine) + size_of(other) <= grain) return _intersection(a, mine, other);
+        if (!mine) return nullptr;
+        if (!other) {
+            _destroy(a, mine);
+            return nullptr;
+        }
+        Node *l, *r;
+        Node* mid = _split(mine, other->data, l, r);
+        Alloc branch;
+        pool.fork_join([&] { l = _par_intersection(branch, l, other->left, pool, grain); },
+                       [&] { r = _par_intersection(a, r, other->right, pool, grain); });
+        a.absorb(branch);
+        return mid ? _join(l, mid, r) : _join2(l, r);
+    }
+
+    Node* _par_difference(Alloc& a, Node* mine, const Node* other, WorkStealingPool& pool, int grain) {
+        if (size_of(mine) + size_of(other) <= grain) return _difference(a, mine, other);
+        if (!mine) return nullptr;
+        if (!other) return mine;
+        Node *l, *r;
+        Node* mid = _split(mine, other->data, l, r);
+        if (mid) a.destroy(mid);
+        Alloc branch;
+        pool.fork_join([&] { l = _par_difference(branch, l, other->left, pool, grain); },
+                       [&] { r = _par_difference(a, r, other->right, pool, grain); });
+        a.absorb(branch);
+        return _join2(l, r);
+    }
+
+    // ranges[first, last) are the queries that may still meet this subtree
     template<typename Fun>
-    void _inorder(Node *node, Fun func) {
-        if (!node) return;
+    void _ranges(Node *node, const pair<T, T>* ranges, int first, int last, Fun& fn) const {
+        if (!node || first >= last) return;
+
+        // ranges starting below the key continue to the left
+        int split = first;
+        while (split < last && ranges[split].first < node->data) ++split;
+        _ranges(node->left, ranges, first, split, fn);
+
+        // at most one disjoint range can contain the key
+        int right = split;
+        if (split > first && !(ranges[split - 1].second < node->data)) {
+            right = split - 1;
+            fn(right, node->data);
+        }
+        if (split < last && !(node->data < ranges[split].first)) {
+            right = split;
+            fn(split, node->data);
+        }
+        // ranges ending above the key continue to the right
+        while (right < last && !(node->data < ranges[right].second)) ++right;
+        _ranges(node->right, ranges, right, last, fn);
+    }
 
-        _inorder(node->left, func);
-        func(node);
-        _inorder(node->right, func);
+    // The traversals keep their own stack of at most MaxHeight nodes
+    template<typename Fun>
+    void _preorder(Node *node, Fun func) {
+        Node* stack[MaxHeight];
+        int depth = 0;
+        while (node || depth > 0) {
+            if (!node) node = stack[--depth];
+            func(node);
+            if (node->right) stack[depth++] = node->right;
+            node = node->left;
+        }
     }
 
     template<typename Fun>
-    void _postorder(Node *node, Fun func) {
-        if (!node) return;
+    void _inorder(Node *node, Fun func) {
+        Node* stack[MaxHeight];
+        int depth = 0;
+        while (node || depth > 0) {
+            for (; node; node = node->left) stack[depth++] = node;
+            node = stack[--depth];
+            func(node);
+            node = node->right;
+        }
+    }
 
-        _postorder(node->left, func);
-        _postorder(node->right, func);
-        func(node);
+    template<typename Fun>
+    void _postorder(Node *node, Fun func) {
+        Node* stack[MaxHeight];
+        int depth = 0;
+        Node* last = nullptr;
+        while (node || depth > 0) {
+            for (; node; node = node->left) stack[depth++] = node;
+            Node* top = stack[depth - 1];
+            if (top->right && top->right != last) {
+                node = top->right;
+            } else {
+                func(top);
+                last = top;
+                depth--;
+            }
+        }
     }
 
     template<typename Fun>
@@ -291,26 +939,44 @@ private:
         return height_of(NodeAVL->left) - height_of(NodeAVL->right);
     }
 
-    void updateHeight(Node *n) {
+    int count_not_greater(const T& value) const {
+        int r = 0;
+        Node *curr = root;
+        while (curr != nullptr) {
+            if (value < curr->data) {
+                curr = curr->left;
+            } else {
+                r += size_of(curr->left) + 1;
+                curr = curr->right;
+            }
+        }
+        return r;
+    }
+
+    // Refreshes height and subtree size from the children
+    void update(Node *n) {
         if (n == nullptr) return;
         n->height = 1 + std::max(height_of(n->left), height_of(n->right));
+        n->size = 1 + size_of(n->left) + size_of(n->right);
     }
 
     Node* balance(Node *&n) {
         if (!n) {
             throw std::runtime_error("Balance func: Node is null");
         }
-        updateHeight(n);
+        update(n);
 
         auto factor = balancingFactor(n);
         // Left
         if (factor > 1) {
             // LL
             if (balancingFactor(n->left) >= 0) {
+                stats.rotation(Rotation::LL);
                 n = right_rotate(n);
             }
             // LR
             else { // balancingFactor(n->left) < 0
+                stats.rotation(Rotation::LR);
                 n->left = left_rotate(n->left);
                 n = right_rotate(n);
             }
@@ -319,10 +985,12 @@ private:
         else if (factor < -1) {
             // RR
             if (balancingFactor(n->right) <= 0) {
+                stats.rotation(Rotation::RR);
                 n = left_rotate(n);
             }
             // RL
             else { // balancingFactor(n->right) > 0
+                stats.rotation(Rotation::RL);
                 n->right = right_rotate(n->right);
                 n = left_rotate(n);
             }
@@ -339,8 +1007,8 @@ private:
         y ->left = x;
         x->right = a;
 
-        updateHeight(x);
-        updateHeight(y);
+        update(x);
+        update(y);
 
         return y;
     }
@@ -352,8 +1020,8 @@ private:
         y->right = x;
         x->left = a;
 
-        updateHeight(x);
-        updateHeight(y);
+        update(x);
+        update(y);
 
         return y;
     }
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Allocation policies for AVLTree nodes.
+// create/destroy handle single nodes, release tears down a whole tree.
+// absorb takes over another allocator's nodes (join), share lets an empty
+// allocator own nodes that were created here (split).
+
+template<typename Node>
+struct HeapNodeAllocator {
+    // every node is independent, so subtrees move between trees as-is
+
+    template<typename... Args>
+    Node* create(Args&&... args) {
+        return new Node(std::forward<Args>(args)...);
+    }
+
+    void destroy(Node* n) {
+        delete n;
+    }
+
+    void release(Node* root) {
+        if (root != nullptr) root->killSelf();
+    }
+
+    void absorb(HeapNodeAllocator&) {
+    }
+
+    void share(HeapNodeAllocator&) {
+    }
+};
+
+// Nodes are carved out of fixed-size slabs and recycled through a free list,
+// so siblings allocated together stay close in memory. release() frees the
+// slabs without visiting nodes when T is trivially destructible.
+//
+// After a split both trees have nodes in the same slabs. share() moves this
+// arena's slabs into a reference-counted group held by both arenas; each
+// keeps its own free list and allocates new nodes from fresh slabs of its
+// own. A group is freed when the last arena holding it is released, so the
+// cells of a released tree's nodes in a shared group are not reused until
+// then.
+template<typename Node, size_t SlabNodes = 256>
+class NodeArena {
+    struct FreeCell {
+        FreeCell* next;
+    };
+
+    struct Slab {
+        Slab* next;
+        alignas(Node) unsigned char cells[SlabNodes][sizeof(Node)];
+    };
+
+    static void delete_slabs(Slab* slab) {
+        while (slab != nullptr) {
+            Slab* next = slab->next;
+            delete slab;
+            slab = next;
+        }
+    }
+
+    struct SlabGroup {
+        Slab* slabs;
+        explicit SlabGroup(Slab* s) : slabs(s) {
+        }
+        SlabGroup(const SlabGroup&) = delete;
+        SlabGroup& operator=(const SlabGroup&) = delete;
+        ~SlabGroup() {
+            delete_slabs(slabs);
+        }
+    };
+
+    static_assert(sizeof(Node) >= sizeof(FreeCell), "Node too small for the free list");
+
+    Slab* slabs;        // only this arena's nodes live here
+    size_t used;        // cells handed out from the newest slab
+    FreeCell* free_list;
+    FreeCell* free_tail;
+    std::vector<std::shared_ptr<SlabGroup>> groups;   // slabs shared with other arenas
+
+    void* take() {
+        if (free_list != nullptr) {
+            void* cell = free_list;
+            free_list = free_list->next;
+            if (free_list == nullptr) free_tail = nullptr;
+            return cell;
+        }
+        if (slabs == nullptr || used == SlabNodes) {
+            Slab* slab = new Slab;
+            slab->next = slabs;
+            slabs = slab;
+            used = 0;
+        }
+        return slabs->cells[used++];
+    }
+
+    // Destroys every node without recursion: rotating left children up
+    // flattens the tree into a right vine that is consumed as we go.
+    static void destroy_all(Node* root) {
+        while (root != nullptr) {
+            if (root->left != nullptr) {
+                Node* l = root->left;
+                root->left = l->right;
+                l->right = root;
+                root = l;
+            } else {
+                Node* next = root->right;
+                root->~Node();
+                root = next;
+            }
+        }
+    }
+
+public:
+    NodeArena() : slabs(nullptr), used(0), free_list(nullptr), free_tail(nullptr) {
+    }
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    NodeArena(NodeArena&& other) noexcept
+        : slabs(other.slabs), used(other.used), free_list(other.free_list), free_tail(other.free_tail),
+          groups(std::move(other.groups)) {
+        other.slabs = nullptr;
+        other.free_list = other.free_tail = nullptr;
+        other.used = 0;
+    }
+
+    NodeArena& operator=(NodeArena&& other) noexcept {
+        if (this != &other) {
+            free_slabs();
+            slabs = other.slabs;
+            used = other.used;
+            free_list = other.free_list;
+            free_tail = other.free_tail;
+            groups = std::move(other.groups);
+            other.slabs = nullptr;
+            other.free_list = other.free_tail = nullptr;
+            other.used = 0;
+        }
+        return *this;
+    }
+
+    ~NodeArena() {
+        free_slabs();
+    }
+
+    template<typename... Args>
+    Node* create(Args&&... args) {
+        void* cell = take();
+        return new (cell) Node(std::forward<Args>(args)...);
+    }
+
+    void destroy(Node* n) {
+        n->~Node();
+        auto cell = reinterpret_cast<FreeCell*>(n);
+        cell->next = free_list;
+        free_list = cell;
+        if (free_tail == nullptr) free_tail = cell;
+    }
+
+    // Takes over other's slabs and groups (and so the nodes living in them)
+    // in O(number of slabs); other is left empty.
+    void absorb(NodeArena& other) {
+        if (slabs == nullptr) {
+            slabs = other.slabs;
+            used = other.used;
+        } else if (other.slabs != nullptr) {
+            // keep our newest slab first so bump allocation continues in it
+            Slab* tail = other.slabs;
+            while (tail->next != nullptr) tail = tail->next;
+            tail->next = slabs->next;
+            slabs->next = other.slabs;
+        }
+        other.slabs = nullptr;
+        other.used = 0;
+        take_free_list(other);
+        take_groups(other);
+    }
+
+    // Lets other, which holds no nodes, own nodes created here: this arena's
+    // slabs become a group held by both, in O(number of groups). Groups only
+    // this arena still holds are folded into the new one, so the count stays
+    // bounded by the number of trees sharing slabs.
+    void share(NodeArena& other) {
+        Slab* mine = slabs;
+        std::vector<std::shared_ptr<SlabGroup>> held;
+        for (auto& group : groups) {
+            if (group.use_count() == 1) {
+                Slab* tail = group->slabs;
+                if (tail == nullptr) continue;
+                while (tail->next != nullptr) tail = tail->next;
+                tail->next = mine;
+                mine = group->slabs;
+                group->slabs = nullptr;
+            } else {
+                held.push_back(std::move(group));
+            }
+        }
+        if (mine != nullptr) held.push_back(std::make_shared<SlabGroup>(mine));
+        groups = std::move(held);
+        slabs = nullptr;
+        used = 0;
+        other.groups.insert(other.groups.end(), groups.begin(), groups.end());
+    }
+
+    void release(Node* root) {
+        if (!std::is_trivially_destructible<Node>::value) {
+            destroy_all(root);
+        }
+        free_slabs();
+    }
+
+private:
+    void take_free_list(NodeArena& other) {
+        if (other.free_list != nullptr) {
+            if (free_list == nullptr) free_list = other.free_list;
+            else free_tail->next = other.free_list;
+            free_tail = other.free_tail;
+        }
+        other.free_list = other.free_tail = nullptr;
+    }
+
+    void take_groups(NodeArena& other) {
+        for (auto& group : other.groups) {
+            bool held = false;
+            for (auto& mine : groups) held = held || mine == group;
+            if (!held) groups.push_back(std::move(group));
+        }
+        other.groups.clear();
+    }
+
+    void free_slabs() {
+        delete_slabs(slabs);
+        slabs = nullptr;
+        used = 0;
+        free_list = free_tail = nullptr;
+        groups.clear();
+    }
+};
@@ -1,133 +1,308 @@
 #pragma once
 
-#include <queue>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
 #include "AVL_Node.h"
 
-template<typename T>
+// Traverses lazily: the iterator only keeps the ancestors of the current
+// node, so begin() is O(height) and a partial scan of k nodes is O(k + height).
+// Node may be const: the iterator only follows data, left and right.
+template<typename T, typename Node = NodeAVL<T> >
 class AVLIterator {
 public:
     enum Type {
-        PreOrder, InOrder, PostOrder, BFS
+        PreOrder, InOrder, PostOrder, BFS, ReverseInOrder
     };
 
 private:
-    using Node = NodeAVL<T>;
+    // an AVL tree of height 64 would need more than 10^13 nodes
+    static const int MaxDepth = 64;
+
+    Node* root;
     Node* current;
-    std::queue<Node*> queue;
+    Node* path[MaxDepth]; // ancestors of current, root first
+    int depth;
+    int level;            // BFS: depth being enumerated
     Type type;
 
-    template<typename Fun>
-    void _preorder(Node *node, Fun func) {
-        if (!node) return;
-
-        func(node);
-        _preorder(node->left, func);
-        _preorder(node->right, func);
+    void push(Node* n) {
+        path[depth++] = n;
     }
 
-    template<typename Fun>
-    void _inorder(Node *node, Fun func) {
-        if (!node) return;
+    Node* pop() {
+        return path[--depth];
+    }
 
-        _inorder(node->left, func);
-        func(node);
-        _inorder(node->right, func);
+    void descend_left(Node* n) {
+        while (n->left) {
+            push(n);
+            n = n->left;
+        }
+        current = n;
     }
 
-    template<typename Fun>
-    void _postorder(Node *node, Fun func) {
-        if (!node) return;
+    void descend_right(Node* n) {
+        while (n->right) {
+            push(n);
+            n = n->right;
+        }
+        current = n;
+    }
 
-        _postorder(node->left, func);
-        _postorder(node->right, func);
-        func(node);
+    void next_inorder() {
+        if (current->right) {
+            push(current);
+            descend_left(current->right);
+            return;
+        }
+        Node* child = current;
+        while (depth > 0) {
+            Node* p = pop();
+            if (p->left == child) {
+                current = p;
+                return;
+            }
+            child = p;
+        }
+        current = nullptr;
     }
 
-    template<typename Fun>
-    void breadth_first_search(Node *node, Fun func) {
-        if (!node) return;
-        std::queue<Node *> q;
-        q.push(node);
+    void prev_inorder() {
+        if (current->left) {
+            push(current);
+            descend_right(current->left);
+            return;
+        }
+        Node* child = current;
+        while (depth > 0) {
+            Node* p = pop();
+            if (p->right == child) {
+                current = p;
+                return;
+            }
+            child = p;
+        }
+        current = nullptr;
+    }
 
-        while (!q.empty()) {
-            auto elem = q.front();
-            q.pop();
-            func(elem);
+    // Moves to the closest right subtree of an ancestor not yet visited in
+    // pre-order. Returns false when there is none left.
+    bool climb_preorder() {
+        Node* child = current;
+        while (depth > 0) {
+            Node* p = path[depth - 1];
+            if (p->left == child && p->right) {
+                current = p->right;
+                return true;
+            }
+            pop();
+            child = p;
+        }
+        return false;
+    }
 
-            if (elem->left) q.push(elem->left);
-            if (elem->right) q.push(elem->right);
+    void next_preorder() {
+        if (current->left) {
+            push(current);
+            current = current->left;
+        } else if (current->right) {
+            push(current);
+            current = current->right;
+        } else if (!climb_preorder()) {
+            current = nullptr;
         }
     }
 
-    static void push_queue(Node* n, std::queue<Node*>& q) {
-        q.push(n);
+    void first_postorder(Node* n) {
+        while (true) {
+            if (n->left) {
+                push(n);
+                n = n->left;
+            } else if (n->right) {
+                push(n);
+                n = n->right;
+            } else {
+                break;
+            }
+        }
+        current = n;
     }
 
-    void _process() {
+    void next_postorder() {
+        if (depth == 0) {
+            current = nullptr;
+            return;
+        }
+        Node* p = pop();
+        if (p->left == current && p->right) {
+            push(p);
+            first_postorder(p->right);
+        } else {
+            current = p;
+        }
+    }
 
-        while (!queue.empty()) {
-            queue.pop();
+    // Walks in pre-order without going deeper than `level` until a node at
+    // exactly that depth is found. Returns false once the tree is exhausted.
+    bool seek_level(bool skip_current) {
+        bool climb = skip_current;
+        while (true) {
+            if (!climb) {
+                if (depth == level) return true;
+                if (current->left) {
+                    push(current);
+                    current = current->left;
+                    continue;
+                }
+                if (current->right) {
+                    push(current);
+                    current = current->right;
+                    continue;
+                }
+            }
+            climb = false;
+            if (!climb_preorder()) return false;
         }
+    }
 
-        if (!current) return;
+    // BFS by iterative deepening: each level is a bounded pre-order walk, which
+    // keeps memory at O(height); on a balanced tree the total work stays O(n).
+    void next_bfs() {
+        if (seek_level(true)) return;
+        ++level;
+        depth = 0;
+        current = root;
+        if (!seek_level(false)) current = nullptr;
+    }
+
+public:
+    // only in-order iterators step back; the other orders throw on --
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    AVLIterator() : root(nullptr), current(nullptr), depth(0), level(0), type(InOrder) {
+    };
+
+    explicit AVLIterator(Node *root, Type type = InOrder, bool at_end = false)
+        : root(root), current(nullptr), depth(0), level(0), type(type) {
+        if (!root || at_end) return;
 
         switch (type) {
             case InOrder:
-                _inorder(current, [this](Node* n){ push_queue(n, queue); });
+                descend_left(root);
+                break;
+            case ReverseInOrder:
+                descend_right(root);
                 break;
             case PostOrder:
-                _postorder(current, [this](Node* n){ push_queue(n, queue); });
+                first_postorder(root);
                 break;
             case PreOrder:
-                _preorder(current, [this](Node* n){ push_queue(n, queue); });
-                break;
             case BFS:
-                breadth_first_search(current, [this](Node* n){ push_queue(n, queue); });
+                current = root;
                 break;
         }
+    }
 
-        if (!queue.empty()) {
-            current = queue.front();
-            queue.pop();
-        } else {
-            current = nullptr;
+    // In-order iterator at the smallest key for which pred holds, where pred
+    // is monotone over the in-order sequence (false ... false true ... true).
+    // The ancestor path is the search path itself, so this is O(height).
+    template<typename Pred>
+    static AVLIterator first_where(Node *root, Pred pred) {
+        AVLIterator it(root, InOrder, true);
+        int found = -1;
+        Node* n = root;
+        while (n) {
+            it.push(n);
+            if (pred(n->data)) {
+                found = it.depth - 1;
+                n = n->left;
+            } else {
+                n = n->right;
+            }
         }
-
+        if (found == -1) {
+            it.depth = 0;
+            return it;
+        }
+        it.depth = found;
+        it.current = it.path[found];
+        return it;
     }
 
-public:
-    AVLIterator() : current(nullptr), type(InOrder) {
-    };
+    bool operator ==(const AVLIterator &other) const {
+        return current == other.current;
+    }
 
-    explicit AVLIterator(NodeAVL<T> *current, Type type = InOrder) : current(current), type(type) {
-        _process();
+    bool operator !=(const AVLIterator &other) const {
+        return current != other.current;
     }
 
-    AVLIterator<T> &operator =(const AVLIterator<T> &other) {
-        if (this != &other) {
-            current = other.current;
-            queue = other.queue;
-            type = other.type;
+    AVLIterator &operator++() {
+        if (!current) return *this;
+
+        switch (type) {
+            case InOrder:
+                next_inorder();
+                break;
+            case ReverseInOrder:
+                prev_inorder();
+                break;
+            case PreOrder:
+                next_preorder();
+                break;
+            case PostOrder:
+                next_postorder();
+                break;
+            case BFS:
+                next_bfs();
+                break;
         }
         return *this;
     }
 
-    bool operator !=(AVLIterator<T> other) const {
-        if (current == nullptr && other.current == nullptr) return false;
-        return current != other.current;
+    AVLIterator operator++(int) {
+        AVLIterator prev = *this;
+        ++*this;
+        return prev;
+    }
+
+    // Only in-order traversals can step back; decrementing end() yields the
+    // last element of the traversal.
+    AVLIterator &operator--() {
+        if (type != InOrder && type != ReverseInOrder) {
+            throw std::runtime_error("Only in-order iterators can be decremented");
+        }
+        bool forward = type == InOrder;
+        if (!current) {
+            depth = 0;
+            if (!root) return *this;
+            if (forward) descend_right(root);
+            else descend_left(root);
+        } else if (forward) {
+            prev_inorder();
+        } else {
+            next_inorder();
+        }
+        return *this;
     }
 
-    AVLIterator<T> &operator++() {
-       if (queue.empty()) current = nullptr;
-       else {
-           current = queue.front();
-           queue.pop();
-       }
-       return *this;
+    AVLIterator operator--(int) {
+        AVLIterator prev = *this;
+        --*this;
+        return prev;
     }
 
-    T operator*() {
+    const T& operator*() const {
         if (!current) throw std::runtime_error("Dereferencing null iterator");
         return current->data;
     }
-};
\ No newline at end of file
+
+    const T* operator->() const {
+        return &**this;
+    }
+};
@@ -1,17 +1,48 @@
 #pragma once
 
+#include <atomic>
+#include <utility>
+
 template <typename T>
 struct NodeAVL {
     T data;
     int height;
+    int size; // nodes in this subtree
     NodeAVL* left; 
     NodeAVL* right;        
-    NodeAVL() : left(nullptr), right(nullptr), height(0) {}   
-    explicit NodeAVL(T value) : data(value), left(nullptr), right(nullptr), height(0) {}
+    NodeAVL() : height(0), size(1), left(nullptr), right(nullptr) {}   
+    explicit NodeAVL(const T& value) : data(value), height(0), size(1), left(nullptr), right(nullptr) {}
+    explicit NodeAVL(T&& value) : data(std::move(value)), height(0), size(1), left(nullptr), right(nullptr) {}
 
+    // Deletes the subtree without recursion: rotating left children up
+    // flattens it into a right vine that is consumed as we go
     void killSelf(){
-        if(left != nullptr) left->killSelf();
-        if(right != nullptr) right->killSelf();
-        delete this;
+        NodeAVL* n = this;
+        while (n != nullptr) {
+            if (n->left != nullptr) {
+                NodeAVL* l = n->left;
+                n->left = l->right;
+                l->right = n;
+                n = l;
+            } else {
+                NodeAVL* next = n->right;
+                delete n;
+                n = next;
+            }
+        }
     }
 };
+
+// Node shared between versions of a PersistentAVLTree. refs counts the
+// parents and trees pointing at it; only a node with a single reference
+// may be changed in place.
+template <typename T>
+struct PersistentNodeAVL {
+    T data;
+    int height;
+    int size;
+    PersistentNodeAVL* left;
+    PersistentNodeAVL* right;
+    std::atomic<int> refs;
+    explicit PersistentNodeAVL(const T& value) : data(value), height(0), size(1), left(nullptr), right(nullptr), refs(1) {}
+};
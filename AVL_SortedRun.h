@@ -0,0 +1,452 @@
+#ifndef AVL_SortedRun_H
+#define AVL_SortedRun_H
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A sorted run is a file of strictly increasing keys, written and read
+// front to back so it works over pipes and sockets as well as files:
+//
+//   header  "AEDRUN\0\0" | version u32 | flags u32 | key count u64 |
+//           FNV-1a of the previous 24 bytes u32
+//   blocks  key count u32 | payload bytes u32 | FNV-1a of payload u32 | payload
+//   end     a block header with a key count of 0
+//   index   (flags & 1) first key and file offset of every block, then
+//           index offset u64 | block count u32 | "AIDX"
+//
+// Keys are compressed per block: the first key of a block is stored whole
+// and every other key relative to its predecessor, so a block decodes on
+// its own. Integers store varint deltas, strings the length of the prefix
+// shared with the previous key plus the rest, and other trivially copyable
+// types their raw bytes. Numbers are little-endian.
+
+namespace sorted_run {
+
+const uint32_t Version = 2;
+const uint32_t Indexed = 1;
+const size_t HeaderBytes = 28;
+// block header: key count, payload bytes, checksum
+const size_t FrameBytes = 12;
+// a block is closed once its payload reaches this size
+const size_t BlockBytes = 16384;
+// larger blocks can only come from a corrupt file
+const size_t MaxBlockBytes = 1 << 26;
+
+inline void put_u32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+inline void put_u64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+inline uint32_t get_u32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+inline uint64_t get_u64(const char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+inline void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+inline bool get_varint(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char byte = static_cast<unsigned char>(*p++);
+        v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline uint32_t checksum(const char* p, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= static_cast<unsigned char>(p[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+inline void write_all(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) throw std::runtime_error("Cannot write sorted run");
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+}
+
+// false if the stream ends first
+inline bool read_all(int fd, char* p, size_t n) {
+    while (n > 0) {
+        ssize_t r = ::read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+inline bool pread_all(int fd, char* p, size_t n, uint64_t offset) {
+    while (n > 0) {
+        ssize_t r = ::pread(fd, p, n, static_cast<off_t>(offset));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= static_cast<size_t>(r);
+        offset += static_cast<uint64_t>(r);
+    }
+    return true;
+}
+
+}
+
+// How keys are encoded; prev is the previous key of the block, or nullptr
+// for the first one. get returns false on malformed input.
+template<typename T, typename Enable = void>
+struct RunCodec {
+    static_assert(std::is_trivially_copyable<T>::value, "Sorted runs store integers, strings or trivially copyable keys");
+
+    static void put(std::string& out, const T& key, const T*) {
+        out.append(reinterpret_cast<const char*>(&key), sizeof(T));
+    }
+
+    static bool get(const char*& p, const char* end, T& key, const T*) {
+        if (end - p < static_cast<long>(sizeof(T))) return false;
+        std::memcpy(&key, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+};
+
+template<typename T>
+struct RunCodec<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+    typedef typename std::make_unsigned<T>::type U;
+
+    static void put(std::string& out, const T& key, const T* prev) {
+        if (prev) sorted_run::put_varint(out, static_cast<U>(static_cast<U>(key) - static_cast<U>(*prev)));
+        else sorted_run::put_u64(out, static_cast<uint64_t>(static_cast<U>(key)));
+    }
+
+    static bool get(const char*& p, const char* end, T& key, const T* prev) {
+        uint64_t v;
+        if (prev) {
+            if (!sorted_run::get_varint(p, end, v)) return false;
+            key = static_cast<T>(static_cast<U>(static_cast<U>(*prev) + static_cast<U>(v)));
+        } else {
+            if (end - p < 8) return false;
+            v = sorted_run::get_u64(p);
+            p += 8;
+            key = static_cast<T>(static_cast<U>(v));
+        }
+        return true;
+    }
+};
+
+template<>
+struct RunCodec<std::string> {
+    static void put(std::string& out, const std::string& key, const std::string* prev) {
+        size_t shared = 0;
+        if (prev) {
+            size_t limit = std::min(prev->size(), key.size());
+            while (shared < limit && (*prev)[shared] == key[shared]) ++shared;
+            sorted_run::put_varint(out, shared);
+        }
+        sorted_run::put_varint(out, key.size() - shared);
+        out.append(key, shared, std::string::npos);
+    }
+
+    static bool get(const char*& p, const char* end, std::string& key, const std::string* prev) {
+        uint64_t shared = 0, rest;
+        if (prev && (!sorted_run::get_varint(p, end, shared) || shared > prev->size())) return false;
+        if (!sorted_run::get_varint(p, end, rest) || rest > static_cast<uint64_t>(end - p)) return false;
+        if (prev) key.assign(*prev, 0, shared);
+        else key.clear();
+        key.append(p, rest);
+        p += rest;
+        return true;
+    }
+};
+
+// Writes `count` strictly increasing keys to fd. Memory use is one block
+// plus, with an index, one first key per block.
+template<typename T>
+class SortedRunWriter {
+    int fd;
+    uint64_t count;
+    uint64_t written;
+    uint64_t offset;
+    bool indexed;
+    std::string block;
+    uint32_t block_keys;
+    T last;
+    std::string index;
+    uint32_t blocks;
+
+    void flush() {
+        if (block_keys == 0) return;
+        std::string frame;
+        sorted_run::put_u32(frame, block_keys);
+        sorted_run::put_u32(frame, static_cast<uint32_t>(block.size()));
+        sorted_run::put_u32(frame, sorted_run::checksum(block.data(), block.size()));
+        sorted_run::write_all(fd, frame.data(), frame.size());
+        sorted_run::write_all(fd, block.data(), block.size());
+        offset += frame.size() + block.size();
+        block.clear();
+        block_keys = 0;
+    }
+
+public:
+    SortedRunWriter(int fd, uint64_t count, bool index = false)
+        : fd(fd), count(count), written(0), offset(0), indexed(index), block_keys(0), blocks(0) {
+        std::string header("AEDRUN\0\0", 8);
+        sorted_run::put_u32(header, sorted_run::Version);
+        sorted_run::put_u32(header, indexed ? sorted_run::Indexed : 0);
+        sorted_run::put_u64(header, count);
+        sorted_run::put_u32(header, sorted_run::checksum(header.data(), header.size()));
+        sorted_run::write_all(fd, header.data(), header.size());
+        offset = header.size();
+    }
+
+    void append(const T& key) {
+        if (written > 0 && !(last < key)) {
+            throw std::invalid_argument("Sorted run keys must be strictly increasing");
+        }
+        if (written == count) throw std::invalid_argument("More keys than announced in the sorted run header");
+        if (block_keys == 0 && indexed) {
+            sorted_run::put_u64(index, offset);
+            RunCodec<T>::put(index, key, nullptr);
+            blocks++;
+        }
+        RunCodec<T>::put(block, key, block_keys == 0 ? nullptr : &last);
+        last = key;
+        block_keys++;
+        written++;
+        if (block.size() >= sorted_run::BlockBytes) flush();
+    }
+
+    void finish() {
+        if (written != count) throw std::invalid_argument("Fewer keys than announced in the sorted run header");
+        flush();
+        std::string tail;
+        sorted_run::put_u32(tail, 0);
+        sorted_run::put_u32(tail, 0);
+        sorted_run::put_u32(tail, 0);
+        if (indexed) {
+            uint64_t index_offset = offset + tail.size();
+            tail += index;
+            sorted_run::put_u64(tail, index_offset);
+            sorted_run::put_u32(tail, blocks);
+            tail.append("AIDX", 4);
+        }
+        sorted_run::write_all(fd, tail.data(), tail.size());
+    }
+};
+
+// Reads a sorted run front to back, holding one block at a time. A
+// malformed run stops the stream and leaves the reason in error().
+template<typename T>
+class SortedRunReader {
+    int fd;
+    uint64_t count;
+    uint64_t delivered;
+    std::string block;
+    const char* p;
+    const char* end;
+    uint32_t left;
+    bool block_start;
+    T current;
+    std::string err;
+
+    bool fail(const char* what) {
+        if (err.empty()) err = std::string("Corrupt sorted run: ") + what;
+        return false;
+    }
+
+    bool load_block() {
+        char frame[sorted_run::FrameBytes];
+        if (!sorted_run::read_all(fd, frame, sizeof(frame))) return fail("truncated");
+        left = sorted_run::get_u32(frame);
+        uint32_t bytes = sorted_run::get_u32(frame + 4);
+        if (left == 0) return fail("fewer keys than the header announces");
+        if (bytes > sorted_run::MaxBlockBytes) return fail("block too large");
+        block.resize(bytes);
+        if (!sorted_run::read_all(fd, &block[0], bytes)) return fail("truncated");
+        if (sorted_run::checksum(block.data(), bytes) != sorted_run::get_u32(frame + 8)) return fail("bad checksum");
+        p = block.data();
+        end = p + bytes;
+        block_start = true;
+        return true;
+    }
+
+public:
+    // The key count sizes the tree a loader builds, so it is trusted only
+    // once the header checksum matches, and never beyond what the rest of a
+    // regular file could hold: every key takes at least one byte.
+    explicit SortedRunReader(int fd) : fd(fd), count(0), delivered(0), p(nullptr), end(nullptr), left(0),
+                                       block_start(true) {
+        char header[sorted_run::HeaderBytes];
+        if (!sorted_run::read_all(fd, header, sizeof(header)) || std::memcmp(header, "AEDRUN\0\0", 8) != 0) {
+            throw std::runtime_error("Not a sorted run");
+        }
+        if (sorted_run::get_u32(header + 8) != sorted_run::Version) {
+            throw std::runtime_error("Unsupported sorted run version");
+        }
+        if (sorted_run::checksum(header, 24) != sorted_run::get_u32(header + 24)) {
+            throw std::runtime_error("Corrupt sorted run: bad header checksum");
+        }
+        count = sorted_run::get_u64(header + 16);
+        struct stat st;
+        off_t at = ::lseek(fd, 0, SEEK_CUR);
+        if (at >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            uint64_t rest = st.st_size > at ? static_cast<uint64_t>(st.st_size - at) : 0;
+            if (count > rest) throw std::runtime_error("Corrupt sorted run: more keys than the file can hold");
+        }
+    }
+
+    uint64_t size() const {
+        return count;
+    }
+
+    const std::string& error() const {
+        return err;
+    }
+
+    bool failed() const {
+        return !err.empty();
+    }
+
+    // Next key in key; false once all keys were read or on a malformed run
+    bool next(T& key) {
+        if (!err.empty() || delivered == count) return false;
+        if (left == 0 && !load_block()) return false;
+        T decoded;
+        if (!RunCodec<T>::get(p, end, decoded, block_start ? nullptr : &current)) return fail("bad key encoding");
+        if (delivered > 0 && !(current < decoded)) return fail("keys out of order");
+        current = std::move(decoded);
+        block_start = false;
+        if (--left == 0 && p != end) return fail("bytes left after the last key of a block");
+        delivered++;
+        if (delivered == count) {
+            if (left != 0) return fail("more keys than the header announces");
+            static const char zeros[sorted_run::FrameBytes] = {};
+            char marker[sorted_run::FrameBytes];
+            if (!sorted_run::read_all(fd, marker, sizeof(marker)) || std::memcmp(marker, zeros, sizeof(marker)) != 0) {
+                return fail("missing end marker");
+            }
+        }
+        key = current;
+        return true;
+    }
+
+    // Input iterator over the keys for builders that take one; after an
+    // error it keeps yielding the last key, so builders check failed()
+    class cursor {
+        SortedRunReader* reader;
+        T key;
+    public:
+        explicit cursor(SortedRunReader* r) : reader(r), key() {
+            reader->next(key);
+        }
+        bool failed() const {
+            return reader->failed();
+        }
+        const T& operator*() const {
+            return key;
+        }
+        cursor& operator++() {
+            reader->next(key);
+            return *this;
+        }
+    };
+
+    cursor keys() {
+        return cursor(this);
+    }
+};
+
+// Looks key up in an indexed run through the sparse index, reading the
+// index and at most one block. fd must be a regular file.
+template<typename T>
+bool sorted_run_contains(int fd, const T& key) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sorted_run::HeaderBytes + sorted_run::FrameBytes + 16)) {
+        throw std::runtime_error("Not an indexed sorted run");
+    }
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    char footer[16];
+    if (!sorted_run::pread_all(fd, footer, sizeof(footer), size - 16) || std::memcmp(footer + 12, "AIDX", 4) != 0) {
+        throw std::runtime_error("Not an indexed sorted run");
+    }
+    uint64_t index_offset = sorted_run::get_u64(footer);
+    uint32_t blocks = sorted_run::get_u32(footer + 8);
+    if (index_offset > size - 16) throw std::runtime_error("Corrupt sorted run: bad index offset");
+
+    std::string index(size - 16 - index_offset, '\0');
+    if (!sorted_run::pread_all(fd, &index[0], index.size(), index_offset)) {
+        throw std::runtime_error("Corrupt sorted run: truncated index");
+    }
+    // last block whose first key is not above key
+    const char* p = index.data();
+    const char* end = p + index.size();
+    uint64_t block_offset = 0;
+    bool found_block = false;
+    for (uint32_t b = 0; b < blocks; ++b) {
+        if (end - p < 8) throw std::runtime_error("Corrupt sorted run: truncated index");
+        uint64_t offset = sorted_run::get_u64(p);
+        p += 8;
+        T first;
+        if (!RunCodec<T>::get(p, end, first, nullptr)) throw std::runtime_error("Corrupt sorted run: bad index key");
+        if (key < first) break;
+        if (!(first < key)) return true;
+        block_offset = offset;
+        found_block = true;
+    }
+    if (!found_block) return false;
+
+    char frame[sorted_run::FrameBytes];
+    if (!sorted_run::pread_all(fd, frame, sizeof(frame), block_offset)) {
+        throw std::runtime_error("Corrupt sorted run: truncated");
+    }
+    uint32_t keys = sorted_run::get_u32(frame);
+    uint32_t bytes = sorted_run::get_u32(frame + 4);
+    if (bytes > sorted_run::MaxBlockBytes) throw std::runtime_error("Corrupt sorted run: block too large");
+    std::string block(bytes, '\0');
+    if (!sorted_run::pread_all(fd, &block[0], bytes, block_offset + sizeof(frame))
+        || sorted_run::checksum(block.data(), bytes) != sorted_run::get_u32(frame + 8)) {
+        throw std::runtime_error("Corrupt sorted run: bad block");
+    }
+    const char* q = block.data();
+    T prev, curr;
+    for (uint32_t i = 0; i < keys; ++i) {
+        if (!RunCodec<T>::get(q, block.data() + bytes, curr, i == 0 ? nullptr : &prev)) {
+            throw std::runtime_error("Corrupt sorted run: bad key encoding");
+        }
+        if (!(curr < key)) return !(key < curr);
+        prev = std::move(curr);
+    }
+    return false;
+}
+
+#endif //AVL_SortedRun_H
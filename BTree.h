@@ -0,0 +1,557 @@
+#ifndef BTree_H
+#define BTree_H
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Position of a key among the sorted keys of a node: lower() counts the keys
+// below it, upper() the keys not above it. The generic version is a binary
+// search; signed integers are compared a whole vector at a time instead,
+// stopping at the first vector that is not entirely on one side.
+template<typename T, int Width = (std::is_integral<T>::value && std::is_signed<T>::value) ? sizeof(T) : 0>
+struct NodeSearch {
+    static int lower(const T* keys, int count, const T& key) {
+        return static_cast<int>(std::lower_bound(keys, keys + count, key) - keys);
+    }
+
+    static int upper(const T* keys, int count, const T& key) {
+        return static_cast<int>(std::upper_bound(keys, keys + count, key) - keys);
+    }
+};
+
+#if defined(__SSE2__)
+template<typename T>
+struct NodeSearch<T, 4> {
+    // keys[i] < key when below, keys[i] <= key otherwise
+    template<bool Below>
+    static int count_before(const T* keys, int count, T key) {
+        int i = 0;
+#if defined(__AVX2__)
+        __m256i k8 = _mm256_set1_epi32(key);
+        for (; i + 8 <= count; i += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            __m256i hit = Below ? _mm256_cmpgt_epi32(k8, v) : _mm256_cmpgt_epi32(v, k8);
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+            if (Below && mask != 0xFF) return i + __builtin_popcount(mask);
+            if (!Below && mask != 0) return i + 8 - __builtin_popcount(mask);
+        }
+#endif
+        __m128i k4 = _mm_set1_epi32(key);
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            __m128i hit = Below ? _mm_cmpgt_epi32(k4, v) : _mm_cmpgt_epi32(v, k4);
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(hit));
+            if (Below && mask != 0xF) return i + __builtin_popcount(mask);
+            if (!Below && mask != 0) return i + 4 - __builtin_popcount(mask);
+        }
+        while (i < count && (Below ? keys[i] < key : !(key < keys[i]))) ++i;
+        return i;
+    }
+
+    static int lower(const T* keys, int count, T key) {
+        return count_before<true>(keys, count, key);
+    }
+
+    static int upper(const T* keys, int count, T key) {
+        return count_before<false>(keys, count, key);
+    }
+};
+#endif
+
+#if defined(__AVX2__)
+template<typename T>
+struct NodeSearch<T, 8> {
+    template<bool Below>
+    static int count_before(const T* keys, int count, T key) {
+        int i = 0;
+        __m256i k4 = _mm256_set1_epi64x(key);
+        for (; i + 4 <= count; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            __m256i hit = Below ? _mm256_cmpgt_epi64(k4, v) : _mm256_cmpgt_epi64(v, k4);
+            int mask = _mm256_movemask_pd(_mm256_castsi256_pd(hit));
+            if (Below && mask != 0xF) return i + __builtin_popcount(mask);
+            if (!Below && mask != 0) return i + 4 - __builtin_popcount(mask);
+        }
+        while (i < count && (Below ? keys[i] < key : !(key < keys[i]))) ++i;
+        return i;
+    }
+
+    static int lower(const T* keys, int count, T key) {
+        return count_before<true>(keys, count, key);
+    }
+
+    static int upper(const T* keys, int count, T key) {
+        return count_before<false>(keys, count, key);
+    }
+};
+#endif
+
+// Keys per node: the key array spans four cache lines, within [16, 64]
+template<typename T>
+struct BTreeNodeKeys {
+    static const int value = 256 / sizeof(T) < 16 ? 16 : (256 / sizeof(T) > 64 ? 64 : 256 / sizeof(T));
+};
+
+// Ordered set stored as a B+ tree: every key lives in a leaf, leaves are
+// chained in order, and inner nodes only route. Nodes hold up to Keys sorted
+// keys and start on a cache line, so a lookup touches a few lines per level
+// over log_Keys(n) levels instead of one line per level over log2(n).
+//
+// T must be default constructible and assignable. Iterators and references
+// are invalidated by insert and remove.
+template<typename T, int Keys = BTreeNodeKeys<T>::value>
+class BTree {
+    static_assert(Keys >= 4, "BTree nodes need at least four keys");
+
+    // below this a node borrows from or merges with a sibling
+    static const int MinKeys = Keys / 2 - 1;
+
+    struct alignas(64) Node {
+        T keys[Keys];
+        int count;
+        bool leaf;
+
+        explicit Node(bool leaf) : keys(), count(0), leaf(leaf) {
+        }
+    };
+
+    struct Inner : Node {
+        Node* children[Keys + 1];
+
+        Inner() : Node(false), children() {
+        }
+    };
+
+    struct Leaf : Node {
+        Leaf* prev;
+        Leaf* next;
+
+        Leaf() : Node(true), prev(nullptr), next(nullptr) {
+        }
+    };
+
+    typedef NodeSearch<T> Search;
+
+    Node* root;
+    Leaf* head;
+    Leaf* tail;
+    int keys_count;
+    int levels;
+    size_t inner_count;
+    size_t leaf_count;
+
+public:
+    class iterator {
+        friend class BTree;
+
+        const BTree* tree;
+        const Leaf* leaf;
+        int index;
+
+        iterator(const BTree* tree, const Leaf* leaf, int index) : tree(tree), leaf(leaf), index(index) {
+            if (leaf && index == leaf->count) {
+                this->leaf = leaf->next;
+                this->index = 0;
+            }
+        }
+
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        iterator() : tree(nullptr), leaf(nullptr), index(0) {
+        }
+
+        bool operator ==(const iterator& other) const {
+            return leaf == other.leaf && index == other.index;
+        }
+
+        bool operator !=(const iterator& other) const {
+            return !(*this == other);
+        }
+
+        iterator& operator++() {
+            if (leaf && ++index == leaf->count) {
+                leaf = leaf->next;
+                index = 0;
+            }
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator prev = *this;
+            ++*this;
+            return prev;
+        }
+
+        // decrementing end() yields the last key
+        iterator& operator--() {
+            if (!leaf) {
+                leaf = tree->tail;
+                index = leaf->count - 1;
+            } else if (index == 0) {
+                leaf = leaf->prev;
+                index = leaf ? leaf->count - 1 : 0;
+            } else {
+                --index;
+            }
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator prev = *this;
+            --*this;
+            return prev;
+        }
+
+        const T& operator*() const {
+            if (!leaf) throw std::runtime_error("Dereferencing null iterator");
+            return leaf->keys[index];
+        }
+
+        const T* operator->() const {
+            return &**this;
+        }
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+
+    BTree() : keys_count(0), levels(1), inner_count(0), leaf_count(1) {
+        Leaf* leaf = new Leaf;
+        root = leaf;
+        head = tail = leaf;
+    }
+
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+
+    ~BTree() {
+        _destroy(root);
+    }
+
+    iterator begin() const {
+        return iterator(this, head, 0);
+    }
+
+    iterator end() const {
+        return iterator(this, nullptr, 0);
+    }
+
+    reverse_iterator rbegin() const {
+        return reverse_iterator(end());
+    }
+
+    reverse_iterator rend() const {
+        return reverse_iterator(begin());
+    }
+
+    // First key not less than value
+    iterator lower_bound(const T& value) const {
+        const Leaf* leaf = _leaf_for(value);
+        return iterator(this, leaf, Search::lower(leaf->keys, leaf->count, value));
+    }
+
+    // First key greater than value
+    iterator upper_bound(const T& value) const {
+        const Leaf* leaf = _leaf_for(value);
+        return iterator(this, leaf, Search::upper(leaf->keys, leaf->count, value));
+    }
+
+    bool find(const T& value) const {
+        const Leaf* leaf = _leaf_for(value);
+        int i = Search::lower(leaf->keys, leaf->count, value);
+        return i < leaf->count && !(value < leaf->keys[i]);
+    }
+
+    // Returns false if value was already present
+    bool insert(const T& value) {
+        Node* split = nullptr;
+        T separator;
+        if (!_insert(root, value, split, separator)) return false;
+        if (split) {
+            Inner* top = new Inner;
+            ++inner_count;
+            top->keys[0] = separator;
+            top->children[0] = root;
+            top->children[1] = split;
+            top->count = 1;
+            root = top;
+            ++levels;
+        }
+        ++keys_count;
+        return true;
+    }
+
+    // Returns false if value was not present
+    bool remove(const T& value) {
+        if (!_remove(root, value)) return false;
+        if (!root->leaf && root->count == 0) {
+            Inner* old = static_cast<Inner*>(root);
+            root = old->children[0];
+            delete old;
+            --inner_count;
+            --levels;
+        }
+        --keys_count;
+        return true;
+    }
+
+    T minValue() const {
+        if (keys_count == 0) throw std::runtime_error("Cannot get min value of an empty tree");
+        return head->keys[0];
+    }
+
+    T maxValue() const {
+        if (keys_count == 0) throw std::runtime_error("Cannot get max value of an empty tree");
+        return tail->keys[tail->count - 1];
+    }
+
+    T successor(const T& value) const {
+        iterator it = upper_bound(value);
+        if (it == end()) throw invalid_argument("No successor for " + to_string(value) + " value");
+        return *it;
+    }
+
+    T predecessor(const T& value) const {
+        iterator it = lower_bound(value);
+        if (it == begin()) throw invalid_argument("No predecessor for " + to_string(value) + " value");
+        return *--it;
+    }
+
+    int size() const {
+        return keys_count;
+    }
+
+    // Levels of nodes, 1 for a single leaf
+    int height() const {
+        return levels;
+    }
+
+    void clear() {
+        _destroy(root);
+        Leaf* leaf = new Leaf;
+        root = leaf;
+        head = tail = leaf;
+        keys_count = 0;
+        levels = 1;
+        inner_count = 0;
+        leaf_count = 1;
+    }
+
+    // Bytes held by nodes
+    size_t memoryUsage() const {
+        return inner_count * sizeof(Inner) + leaf_count * sizeof(Leaf);
+    }
+
+private:
+    const Leaf* _leaf_for(const T& value) const {
+        const Node* n = root;
+        while (!n->leaf) {
+            const Inner* in = static_cast<const Inner*>(n);
+            n = in->children[Search::upper(in->keys, in->count, value)];
+        }
+        return static_cast<const Leaf*>(n);
+    }
+
+    void _destroy(Node* n) {
+        if (!n->leaf) {
+            Inner* in = static_cast<Inner*>(n);
+            for (int i = 0; i <= in->count; ++i) _destroy(in->children[i]);
+            delete in;
+        } else {
+            delete static_cast<Leaf*>(n);
+        }
+    }
+
+    static void _insert_at(T* keys, int count, int i, const T& value) {
+        std::move_backward(keys + i, keys + count, keys + count + 1);
+        keys[i] = value;
+    }
+
+    // Inserts into the subtree at n. When n had to split, split receives the
+    // new right sibling and separator the smallest key routed to it.
+    bool _insert(Node* n, const T& value, Node*& split, T& separator) {
+        if (n->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(n);
+            int i = Search::lower(leaf->keys, leaf->count, value);
+            if (i < leaf->count && !(value < leaf->keys[i])) return false;
+            if (leaf->count == Keys) {
+                Leaf* right = _split_leaf(leaf);
+                split = right;
+                int kept = leaf->count;
+                if (i > kept) {
+                    leaf = right;
+                    i -= kept;
+                }
+            }
+            _insert_at(leaf->keys, leaf->count, i, value);
+            ++leaf->count;
+            if (split) separator = static_cast<Leaf*>(split)->keys[0];
+            return true;
+        }
+
+        Inner* in = static_cast<Inner*>(n);
+        int i = Search::upper(in->keys, in->count, value);
+        Node* child_split = nullptr;
+        T child_separator;
+        if (!_insert(in->children[i], value, child_split, child_separator)) return false;
+        if (!child_split) return true;
+
+        if (in->count == Keys) {
+            Inner* right = _split_inner(in, separator);
+            split = right;
+            // the separator between the halves moved up
+            int kept = in->count;
+            if (i > kept) {
+                in = right;
+                i -= kept + 1;
+            }
+        }
+        _insert_at(in->keys, in->count, i, child_separator);
+        std::move_backward(in->children + i + 1, in->children + in->count + 1, in->children + in->count + 2);
+        in->children[i + 1] = child_split;
+        ++in->count;
+        return true;
+    }
+
+    Leaf* _split_leaf(Leaf* leaf) {
+        Leaf* right = new Leaf;
+        ++leaf_count;
+        int keep = Keys / 2;
+        std::move(leaf->keys + keep, leaf->keys + Keys, right->keys);
+        right->count = Keys - keep;
+        leaf->count = keep;
+
+        right->prev = leaf;
+        right->next = leaf->next;
+        if (leaf->next) leaf->next->prev = right;
+        else tail = right;
+        leaf->next = right;
+        return right;
+    }
+
+    // The middle key moves up as separator
+    Inner* _split_inner(Inner* in, T& separator) {
+        Inner* right = new Inner;
+        ++inner_count;
+        int keep = Keys / 2;
+        separator = in->keys[keep];
+        std::move(in->keys + keep + 1, in->keys + Keys, right->keys);
+        std::copy(in->children + keep + 1, in->children + Keys + 1, right->children);
+        right->count = Keys - keep - 1;
+        in->count = keep;
+        return right;
+    }
+
+    // Separators are left alone when the key they copy goes away: they still
+    // route correctly, since every key right of one is not below it
+    bool _remove(Node* n, const T& value) {
+        if (n->leaf) {
+            int i = Search::lower(n->keys, n->count, value);
+            if (i == n->count || value < n->keys[i]) return false;
+            std::move(n->keys + i + 1, n->keys + n->count, n->keys + i);
+            --n->count;
+            return true;
+        }
+
+        Inner* in = static_cast<Inner*>(n);
+        int i = Search::upper(in->keys, in->count, value);
+        if (!_remove(in->children[i], value)) return false;
+        if (in->children[i]->count < MinKeys) _fix_underflow(in, i);
+        return true;
+    }
+
+    // Child i of in has one key too few: borrow one from a sibling that can
+    // spare it, or merge with a sibling otherwise
+    void _fix_underflow(Inner* in, int i) {
+        if (i > 0 && in->children[i - 1]->count > MinKeys) {
+            _borrow_from_left(in, i);
+        } else if (i < in->count && in->children[i + 1]->count > MinKeys) {
+            _borrow_from_right(in, i);
+        } else if (i > 0) {
+            _merge(in, i - 1);
+        } else {
+            _merge(in, i);
+        }
+    }
+
+    void _borrow_from_left(Inner* in, int i) {
+        Node* child = in->children[i];
+        Node* left = in->children[i - 1];
+        if (child->leaf) {
+            _insert_at(child->keys, child->count, 0, left->keys[left->count - 1]);
+            in->keys[i - 1] = child->keys[0];
+        } else {
+            Inner* c = static_cast<Inner*>(child);
+            Inner* l = static_cast<Inner*>(left);
+            _insert_at(c->keys, c->count, 0, in->keys[i - 1]);
+            std::move_backward(c->children, c->children + c->count + 1, c->children + c->count + 2);
+            c->children[0] = l->children[l->count];
+            in->keys[i - 1] = l->keys[l->count - 1];
+        }
+        ++child->count;
+        --left->count;
+    }
+
+    void _borrow_from_right(Inner* in, int i) {
+        Node* child = in->children[i];
+        Node* right = in->children[i + 1];
+        if (child->leaf) {
+            child->keys[child->count] = right->keys[0];
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            in->keys[i] = right->keys[0];
+        } else {
+            Inner* c = static_cast<Inner*>(child);
+            Inner* r = static_cast<Inner*>(right);
+            c->keys[c->count] = in->keys[i];
+            c->children[c->count + 1] = r->children[0];
+            in->keys[i] = r->keys[0];
+            std::move(r->keys + 1, r->keys + r->count, r->keys);
+            std::copy(r->children + 1, r->children + r->count + 1, r->children);
+        }
+        ++child->count;
+        --right->count;
+    }
+
+    // Folds child i + 1 of in into child i
+    void _merge(Inner* in, int i) {
+        Node* left = in->children[i];
+        Node* right = in->children[i + 1];
+        if (left->leaf) {
+            Leaf* l = static_cast<Leaf*>(left);
+            Leaf* r = static_cast<Leaf*>(right);
+            std::move(r->keys, r->keys + r->count, l->keys + l->count);
+            l->count += r->count;
+            l->next = r->next;
+            if (r->next) r->next->prev = l;
+            else tail = l;
+            delete r;
+            --leaf_count;
+        } else {
+            Inner* l = static_cast<Inner*>(left);
+            Inner* r = static_cast<Inner*>(right);
+            l->keys[l->count] = in->keys[i];
+            std::move(r->keys, r->keys + r->count, l->keys + l->count + 1);
+            std::copy(r->children, r->children + r->count + 1, l->children + l->count + 1);
+            l->count += r->count + 1;
+            delete r;
+            --inner_count;
+        }
+        std::move(in->keys + i + 1, in->keys + in->count, in->keys + i);
+        std::copy(in->children + i + 2, in->children + in->count + 1, in->children + i + 1);
+        --in->count;
+    }
+};
+
+#endif //BTree_H
@@ -0,0 +1,575 @@
+#ifndef ConcurrentAVLTree_H
+#define ConcurrentAVLTree_H
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "Epoch.h"
+
+using namespace std;
+
+// Ordered set for many readers and several writers, after Bronson et al.,
+// "A Practical Concurrent Binary Search Tree" (PPoPP 2010).
+//
+// find() takes no lock and writes no shared memory. It descends hand over hand:
+// after reading a child it checks that the parent's version is unchanged, and
+// when a rotation has moved the parent's key range it retries from one level up.
+// A rotation marks the node that moves down as shrinking while the pointers
+// change and bumps its version afterwards.
+//
+// Writers search the same way and then lock only the nodes they change,
+// always a parent before its child: the parent of a new leaf, the node and
+// its parent to unlink it, and for a rotation the parent, the node, its
+// taller child and, for a double rotation, that child's inner child. What
+// was decided from the search is checked again under the locks, and heights
+// are only hints outside them: each writer walks up from the nodes it
+// changed, refreshing heights and rotating until a node needs nothing.
+// Writers never wait for readers.
+//
+// Removing a key whose node has two children only clears its present flag and
+// leaves a routing node behind; routing nodes are unlinked as soon as they are
+// down to one child. Keys therefore never move between nodes, and unlinked
+// nodes are freed through epoch reclamation once no reader or writer can
+// hold them.
+//
+// minValue/maxValue/successor/predecessor may cross several subtrees, so they
+// validate against tree-wide counters of started and finished changes
+// instead, and after a few failed attempts they hold new changes back until
+// the ones in flight have finished and read then.
+template<typename T>
+class ConcurrentAVLTree {
+    struct Node {
+        const T key;
+        std::atomic<bool> present;
+        std::atomic<unsigned long long> version;
+        std::atomic<Node*> left;
+        std::atomic<Node*> right;
+        // only writers read these; they change under the node's lock
+        std::atomic<Node*> parent;
+        std::atomic<int> height;
+        std::mutex lock;
+
+        Node(const T& key, Node* parent)
+            : key(key), present(true), version(0), left(nullptr), right(nullptr), parent(parent), height(1) {
+        }
+
+        std::atomic<Node*>& link(bool go_right) {
+            return go_right ? right : left;
+        }
+
+        Node* child(bool go_right) const {
+            return (go_right ? right : left).load(std::memory_order_acquire);
+        }
+    };
+
+    static const unsigned long long Unlinked = 1;
+    static const unsigned long long Shrinking = 2;
+    static const unsigned long long VersionStep = 4;
+    // an AVL tree of height 128 would need more than 10^26 nodes
+    static const int MaxDepth = 128;
+    static const int OptimisticAttempts = 8;
+
+    enum Result { Found, Missing, Retry };
+
+    // what rebalance() has to do at a node, judged from its children
+    enum Repair { Nothing, Refresh, Unlink, Rotate };
+
+    std::atomic<Node*> root;
+    std::atomic<int> count;
+    // changes to links and present flags, counted when they start and when
+    // they finish; equal while no writer is changing the tree
+    std::atomic<unsigned long long> started;
+    std::atomic<unsigned long long> commits;
+    // set while a scan holds new changes back
+    mutable std::atomic<bool> draining;
+    std::mutex root_lock;                // the parent's lock for the root
+    mutable std::mutex scan_lock;
+    std::mutex retire_lock;
+    RetireList retired;
+
+public:
+    ConcurrentAVLTree() : root(nullptr), count(0), started(0), commits(0), draining(false) {
+    }
+
+    ConcurrentAVLTree(const ConcurrentAVLTree&) = delete;
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree&) = delete;
+
+    // no reader may still be using the tree
+    ~ConcurrentAVLTree() {
+        std::vector<Node*> pending;
+        if (Node* r = root.load()) pending.push_back(r);
+        while (!pending.empty()) {
+            Node* n = pending.back();
+            pending.pop_back();
+            if (Node* l = n->left.load()) pending.push_back(l);
+            if (Node* r = n->right.load()) pending.push_back(r);
+            delete n;
+        }
+    }
+
+    // Returns false if value was already present
+    bool insert(const T& value) {
+        bool added = false;
+        {
+            EpochGuard guard;
+            while (true) {
+                Node* at;
+                unsigned long long at_version;
+                if (locate(value, at, at_version) == Found) {
+                    std::lock_guard<std::mutex> g(at->lock);
+                    if (unlinked(at)) continue;
+                    if (at->present.load(std::memory_order_relaxed)) break;
+                    // a routing node takes the key back
+                    begin_commit();
+                    at->present.store(true, std::memory_order_release);
+                    end_commit();
+                    added = true;
+                    break;
+                }
+                {
+                    // at is where the search ended: it must still be there,
+                    // with the same key range and the link still empty
+                    std::lock_guard<std::mutex> g(lock_of(at));
+                    bool go_right = at != nullptr && at->key < value;
+                    if (at == nullptr ? root.load(std::memory_order_relaxed) != nullptr
+                                      : at->version.load(std::memory_order_relaxed) != at_version
+                                        || at->child(go_right) != nullptr) {
+                        continue;
+                    }
+                    Node* fresh = new Node(value, at);
+                    begin_commit();
+                    if (at == nullptr) root.store(fresh, std::memory_order_release);
+                    else at->link(go_right).store(fresh, std::memory_order_release);
+                    end_commit();
+                }
+                rebalance(at);
+                added = true;
+                break;
+            }
+        }
+        if (added) count.fetch_add(1, std::memory_order_relaxed);
+        reclaim();
+        return added;
+    }
+
+    // Returns false if value was not present
+    bool remove(const T& value) {
+        bool removed = false;
+        {
+            EpochGuard guard;
+            while (true) {
+                Node* n;
+                unsigned long long n_version;
+                if (locate(value, n, n_version) != Found || !n->present.load(std::memory_order_acquire)) break;
+                if (n->left.load(std::memory_order_acquire) != nullptr && n->right.load(std::memory_order_acquire) != nullptr) {
+                    // stays as a routing node, which only needs n itself
+                    std::lock_guard<std::mutex> g(n->lock);
+                    if (unlinked(n) || n->left.load(std::memory_order_relaxed) == nullptr
+                        || n->right.load(std::memory_order_relaxed) == nullptr) {
+                        continue;
+                    }
+                    if (!n->present.load(std::memory_order_relaxed)) break;
+                    begin_commit();
+                    n->present.store(false, std::memory_order_release);
+                    end_commit();
+                    removed = true;
+                    break;
+                }
+                Node* parent = n->parent.load(std::memory_order_acquire);
+                {
+                    std::lock_guard<std::mutex> gp(lock_of(parent));
+                    if (!attached(parent, n)) continue;
+                    std::lock_guard<std::mutex> gn(n->lock);
+                    if (!n->present.load(std::memory_order_relaxed)) break;
+                    begin_commit();
+                    // readers that already reached n see the key gone before n is unlinked
+                    n->present.store(false, std::memory_order_release);
+                    if (n->left.load(std::memory_order_relaxed) == nullptr || n->right.load(std::memory_order_relaxed) == nullptr) {
+                        unlink(n);
+                    }
+                    end_commit();
+                }
+                rebalance(parent);
+                removed = true;
+                break;
+            }
+        }
+        if (removed) count.fetch_sub(1, std::memory_order_relaxed);
+        reclaim();
+        return removed;
+    }
+
+    bool find(const T& value) const {
+        EpochGuard guard;
+        Node* n;
+        unsigned long long n_version;
+        return locate(value, n, n_version) == Found && n->present.load(std::memory_order_acquire);
+    }
+
+    T minValue() const {
+        T out;
+        if (scan(nullptr, true, out) == Missing) throw std::runtime_error("Cannot get min value of an empty tree");
+        return out;
+    }
+
+    T maxValue() const {
+        T out;
+        if (scan(nullptr, false, out) == Missing) throw std::runtime_error("Cannot get max value of an empty tree");
+        return out;
+    }
+
+    T successor(const T& value) const {
+        T out;
+        if (scan(&value, true, out) == Missing) {
+            throw invalid_argument("No successor for " + to_string(value) + " value");
+        }
+        return out;
+    }
+
+    T predecessor(const T& value) const {
+        T out;
+        if (scan(&value, false, out) == Missing) {
+            throw invalid_argument("No predecessor for " + to_string(value) + " value");
+        }
+        return out;
+    }
+
+    int size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Heights and parents are stored and then the other read both by a
+    // writer refreshing a height and by one rotating above it, so their
+    // accesses are sequentially consistent: one of the two sees the other.
+    static int height_of(const Node* n) {
+        return n == nullptr ? 0 : n->height.load();
+    }
+
+    static bool unlinked(const Node* n) {
+        return n->version.load(std::memory_order_acquire) & Unlinked;
+    }
+
+    static void wait_while_shrinking(const Node* n) {
+        while (n->version.load(std::memory_order_acquire) & Shrinking) std::this_thread::yield();
+    }
+
+    // Finds the node holding key (Found) or the node whose empty link key
+    // belongs under (Missing, at == nullptr for an empty tree), with the
+    // version at which that was validated. A node found may be a routing node.
+    Result locate(const T& key, Node*& at, unsigned long long& at_version) const {
+        while (true) {
+            Node* r = root.load(std::memory_order_acquire);
+            at = r;
+            if (r == nullptr) return Missing;
+            if (!(key < r->key) && !(r->key < key)) return Found;
+            unsigned long long v = r->version.load(std::memory_order_acquire);
+            if (v & (Shrinking | Unlinked)) {
+                wait_while_shrinking(r);
+                continue;
+            }
+            // root plays the parent's part for the root node
+            if (r != root.load(std::memory_order_acquire)) continue;
+            Result res = attempt_locate(key, r, v, at, at_version);
+            if (res != Retry) return res;
+        }
+    }
+
+    // Looks for key below r, which had version r_version when locate() read it
+    // as the root. The validated search path is kept so that when a rotation
+    // changes a node's range only that level is searched again; Retry means
+    // the range of r itself changed.
+    Result attempt_locate(const T& key, Node* r, unsigned long long r_version, Node*& at,
+                          unsigned long long& at_version) const {
+        Node* path[MaxDepth];
+        unsigned long long versions[MaxDepth];
+        const std::atomic<Node*>* links[MaxDepth]; // the child pointer followed at each level
+        path[0] = r;
+        versions[0] = r_version;
+        links[0] = r->key < key ? &r->right : &r->left;
+        int depth = 1;
+        while (depth > 0) {
+            Node* node = path[depth - 1];
+            Node* c = links[depth - 1]->load(std::memory_order_acquire);
+            if (c == nullptr) {
+                if (node->version.load(std::memory_order_acquire) == versions[depth - 1]) {
+                    at = node;
+                    at_version = versions[depth - 1];
+                    return Missing;
+                }
+                --depth;
+                continue;
+            }
+            // keys never move, so reaching c is enough to answer for it
+            const std::atomic<Node*>* next;
+            if (key < c->key) next = &c->left;
+            else if (c->key < key) next = &c->right;
+            else {
+                at = c;
+                return Found;
+            }
+
+            unsigned long long v = c->version.load(std::memory_order_acquire);
+            if (v & (Shrinking | Unlinked)) {
+                // an unlinked child has already been replaced in node
+                wait_while_shrinking(c);
+            } else if (c == links[depth - 1]->load(std::memory_order_acquire)) {
+                if (node->version.load(std::memory_order_acquire) != versions[depth - 1]) {
+                    --depth;
+                } else if (depth == MaxDepth) {
+                    return Retry;
+                } else {
+                    path[depth] = c;
+                    versions[depth] = v;
+                    links[depth] = next;
+                    ++depth;
+                }
+            }
+        }
+        return Retry;
+    }
+
+    // In-order walk from the bound (or from the ends without one) to the first
+    // present key strictly beyond it, skipping routing nodes
+    Result scan(const T* bound, bool forward, T& out) const {
+        EpochGuard guard;
+        for (int attempt = 0; attempt < OptimisticAttempts; ++attempt) {
+            unsigned long long seen = commits.load();
+            if (started.load() != seen) {
+                std::this_thread::yield();
+                continue;
+            }
+            Result res = walk(bound, forward, seen, out);
+            if (res != Retry && started.load() == seen) return res;
+        }
+        // writers that start from here on back out and wait (begin_commit)
+        std::lock_guard<std::mutex> g(scan_lock);
+        draining.store(true);
+        unsigned long long seen;
+        while ((seen = commits.load()) != started.load()) std::this_thread::yield();
+        Result res = walk(bound, forward, seen, out);
+        draining.store(false);
+        return res;
+    }
+
+    // A walk racing a writer may see a torn tree; it gives up as soon as a
+    // change starts or the path gets deeper than any valid tree.
+    Result walk(const T* bound, bool forward, unsigned long long seen, T& out) const {
+        Node* path[MaxDepth];
+        int depth = 0;
+        int steps = 0;
+        Node* n = root.load(std::memory_order_acquire);
+        while (n != nullptr) {
+            if (depth == MaxDepth || stale(seen, ++steps)) return Retry;
+            bool beyond = bound == nullptr || (forward ? *bound < n->key : n->key < *bound);
+            if (beyond) {
+                path[depth++] = n;
+                n = n->child(!forward);
+            } else {
+                n = n->child(forward);
+            }
+        }
+        while (depth > 0) {
+            Node* c = path[--depth];
+            if (c->present.load(std::memory_order_acquire)) {
+                out = c->key;
+                return Found;
+            }
+            for (Node* m = c->child(forward); m != nullptr; m = m->child(!forward)) {
+                if (depth == MaxDepth || stale(seen, ++steps)) return Retry;
+                path[depth++] = m;
+            }
+        }
+        return Missing;
+    }
+
+    bool stale(unsigned long long seen, int steps) const {
+        return (steps & 63) == 0 && started.load() != seen;
+    }
+
+    // Called with the nodes to change locked, so a writer waiting here while
+    // a scan drains holds nobody up that the scan waits for
+    void begin_commit() {
+        while (true) {
+            started.fetch_add(1);
+            if (!draining.load()) return;
+            commits.fetch_add(1);
+            while (draining.load()) std::this_thread::yield();
+        }
+    }
+
+    void end_commit() {
+        commits.fetch_add(1);
+    }
+
+    std::mutex& lock_of(Node* n) {
+        return n == nullptr ? root_lock : n->lock;
+    }
+
+    // Whether parent, whose lock is held, is still n's parent
+    bool attached(Node* parent, Node* n) const {
+        if (n->parent.load(std::memory_order_relaxed) != parent) return false;
+        if (parent == nullptr) return root.load(std::memory_order_relaxed) == n;
+        return !unlinked(parent) && (parent->left.load(std::memory_order_relaxed) == n
+                                     || parent->right.load(std::memory_order_relaxed) == n);
+    }
+
+    void reclaim() {
+        std::unique_lock<std::mutex> g(retire_lock, std::try_to_lock);
+        if (g.owns_lock()) retired.reclaim();
+    }
+
+    void replace_child(Node* parent, Node* old_child, Node* new_child) {
+        if (parent == nullptr) root.store(new_child, std::memory_order_release);
+        else parent->link(parent->right.load(std::memory_order_relaxed) == old_child).store(new_child, std::memory_order_release);
+        if (new_child != nullptr) new_child->parent.store(parent);
+    }
+
+    // Removes n, which has at most one child, from the tree. n and its
+    // parent are locked.
+    void unlink(Node* n) {
+        Node* c = n->left.load(std::memory_order_relaxed);
+        if (c == nullptr) c = n->right.load(std::memory_order_relaxed);
+        replace_child(n->parent.load(std::memory_order_relaxed), n, c);
+        n->version.store(n->version.load(std::memory_order_relaxed) | Unlinked, std::memory_order_release);
+        std::lock_guard<std::mutex> g(retire_lock);
+        retired.retire(n);
+    }
+
+    void begin_shrink(Node* n) {
+        n->version.store(n->version.load(std::memory_order_relaxed) | Shrinking, std::memory_order_relaxed);
+    }
+
+    void end_shrink(Node* n) {
+        unsigned long long v = n->version.load(std::memory_order_relaxed);
+        n->version.store((v & ~Shrinking) + VersionStep, std::memory_order_release);
+    }
+
+    static int fresh_height(const Node* n) {
+        return 1 + std::max(height_of(n->left.load(std::memory_order_acquire)),
+                            height_of(n->right.load(std::memory_order_acquire)));
+    }
+
+    void fix_height(Node* n) {
+        n->height.store(fresh_height(n));
+    }
+
+    // n moves down on the side opposite to go_right and its child on that side
+    // takes its place. Only n's key range shrinks, so only n changes version.
+    // n, its parent and the child are locked.
+    Node* rotate(Node* n, bool go_right) {
+        Node* parent = n->parent.load(std::memory_order_relaxed);
+        Node* up = n->child(!go_right);
+        Node* inner = up->child(go_right);
+
+        begin_shrink(n);
+        n->link(!go_right).store(inner, std::memory_order_release);
+        if (inner != nullptr) inner->parent.store(n);
+        up->link(go_right).store(n, std::memory_order_release);
+        n->parent.store(up);
+        replace_child(parent, n, up);
+        fix_height(n);
+        fix_height(up);
+        end_shrink(n);
+        return up;
+    }
+
+    // A rotation can leave the node it moved down as a routing node with a
+    // single child, which must leave the tree too
+    void trim(Node* n) {
+        if (!n->present.load(std::memory_order_relaxed)
+            && (n->left.load(std::memory_order_relaxed) == nullptr || n->right.load(std::memory_order_relaxed) == nullptr)) {
+            unlink(n);
+        }
+    }
+
+    // Judged without locks, so only a hint until rechecked under them
+    static Repair needs(const Node* n) {
+        Node* l = n->left.load(std::memory_order_acquire);
+        Node* r = n->right.load(std::memory_order_acquire);
+        if (!n->present.load(std::memory_order_acquire) && (l == nullptr || r == nullptr)) return Unlink;
+        int factor = height_of(l) - height_of(r);
+        if (factor > 1 || factor < -1) return Rotate;
+        return fresh_height(n) == height_of(n) ? Nothing : Refresh;
+    }
+
+    // Walks from n to the root unlinking routing nodes left with one child,
+    // rotating where the heights differ by two and refreshing heights, until
+    // a node needs nothing. Each step locks the nodes it changes. The walk
+    // only stops under the node's lock: a writer that changed a child's
+    // height before then is seen, and one that changes it later walks up
+    // here itself. Whoever unlinks a node walks on from its parent. After a
+    // rotation the new top of the subtree has a fresh height but the
+    // subtree's height may have changed, so the walk goes on to its parent.
+    void rebalance(Node* n) {
+        bool rotated = false;
+        while (n != nullptr && !unlinked(n)) {
+            Repair repair = needs(n);
+            if (repair == Nothing || repair == Refresh) {
+                std::lock_guard<std::mutex> g(n->lock);
+                if (unlinked(n)) return;
+                repair = needs(n);
+                if (repair == Nothing && !rotated) return;
+                if (repair == Nothing || repair == Refresh) {
+                    fix_height(n);
+                    n = n->parent.load();
+                    rotated = false;
+                }
+                continue;
+            }
+            Node* parent = n->parent.load(std::memory_order_acquire);
+            std::lock_guard<std::mutex> gp(lock_of(parent));
+            if (!attached(parent, n)) continue;
+            std::lock_guard<std::mutex> gn(n->lock);
+            n = repair_locked(n, parent, rotated);
+        }
+    }
+
+    // The step of rebalance at n with n and parent locked; returns the node
+    // to look at next and sets rotated when that is the top of a rotation
+    Node* repair_locked(Node* n, Node* parent, bool& rotated) {
+        rotated = false;
+        Node* l = n->left.load(std::memory_order_relaxed);
+        Node* r = n->right.load(std::memory_order_relaxed);
+        if (!n->present.load(std::memory_order_relaxed) && (l == nullptr || r == nullptr)) {
+            begin_commit();
+            unlink(n);
+            end_commit();
+            return parent;
+        }
+        int factor = height_of(l) - height_of(r);
+        if (factor <= 1 && factor >= -1) {
+            fix_height(n);
+            return parent;
+        }
+        bool go_right = factor > 1;
+        Node* tall = go_right ? l : r;
+        std::lock_guard<std::mutex> gt(tall->lock);
+        Node* inner = tall->child(go_right);
+        Node* outer = tall->child(!go_right);
+        // LR / RL
+        if (height_of(outer) < height_of(inner)) {
+            std::lock_guard<std::mutex> gi(inner->lock);
+            begin_commit();
+            rotate(tall, !go_right);
+            trim(tall);
+            rotate(n, go_right);
+            trim(n);
+            end_commit();
+            // heights below inner may have changed, so it is checked again
+            rotated = true;
+            return inner;
+        }
+        begin_commit();
+        Node* top = rotate(n, go_right);
+        trim(n);
+        end_commit();
+        rotated = true;
+        return top;
+    }
+};
+
+#endif //ConcurrentAVLTree_H
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
+#include "HashTable.h"
+
+//hashtable para varios hilos: las llaves se reparten entre shards independientes, cada uno
+//con su propio HashTable (que redimensiona por su cuenta) y su propio lock lector-escritor.
+//Cada entrada guarda un numero de secuencia de su shard: los inserts de shards distintos no
+//comparten ningun contador, y getAllKeys ordena por (secuencia, shard).
+template <typename TK, typename TV, typename Hash = DefaultHash<TK>, typename KeyEqual = DefaultKeyEqual<TK>>
+class ConcurrentHashTable
+{
+private:
+    struct Stamped {
+        TV value;
+        unsigned long long seq;
+        Stamped(const TV& v, unsigned long long s) : value(v), seq(s) {}
+    };
+
+    //los shards no usan rehash incremental: asi find/at nunca modifican la tabla con el lock compartido
+    typedef HashTable<TK, Stamped, Hash, KeyEqual> Table;
+
+    //cada shard en su propia linea de cache para que los locks no compartan linea
+    struct alignas(64) Shard {
+        mutable std::shared_mutex lock;
+        Table table;
+        unsigned long long sequence;   //se cambia con el lock exclusivo
+        explicit Shard(int cap) : table(cap), sequence(0) {}
+    };
+
+    Shard* shards;
+    int shard_bits;
+    int shard_count;
+    Hash hasher;
+
+    //se usan los bits altos para no correlacionar con el indice dentro del shard
+    Shard& shard_of(const TK& key) const {
+        if (shard_bits == 0) return shards[0];
+        unsigned long long h = hasher(key) * 0x9E3779B97F4A7C15ULL;
+        return shards[h >> (64 - shard_bits)];
+    }
+
+    template <typename Fun>
+    void collect(Fun emit) const {
+        std::vector<pair<unsigned long long, pair<TK, TV>>> items;
+        std::vector<size_t> runs;
+        for (int i = 0; i < shard_count; ++i) {
+            std::shared_lock<std::shared_mutex> g(shards[i].lock);
+            runs.push_back(items.size());
+            for (auto& kv : shards[i].table) {
+                items.push_back({kv.second.seq, {kv.first, kv.second.value}});
+            }
+        }
+        runs.push_back(items.size());
+
+        //cada shard ya esta ordenado por secuencia: se mezclan las corridas de a pares.
+        //inplace_merge es estable y las corridas van por indice de shard, asi que
+        //a igual secuencia queda primero el shard menor
+        auto by_seq = [](const pair<unsigned long long, pair<TK, TV>>& a,
+                         const pair<unsigned long long, pair<TK, TV>>& b) { return a.first < b.first; };
+        for (size_t width = 1; width < runs.size() - 1; width *= 2) {
+            for (size_t i = 0; i + width < runs.size() - 1; i += 2 * width) {
+                size_t last = std::min(i + 2 * width, runs.size() - 1);
+                std::inplace_merge(items.begin() + runs[i], items.begin() + runs[i + width],
+                                   items.begin() + runs[last], by_seq);
+            }
+        }
+        for (auto& item : items) emit(item.second);
+    }
+
+public:
+    //shards se redondea a potencia de dos; _cap es la capacidad inicial de cada shard
+    explicit ConcurrentHashTable(int _shards = 16, int _cap = 5) : shard_bits(0) {
+        while ((1 << shard_bits) < _shards) ++shard_bits;
+        shard_count = 1 << shard_bits;
+        shards = static_cast<Shard*>(::operator new(sizeof(Shard) * shard_count, std::align_val_t(alignof(Shard))));
+        for (int i = 0; i < shard_count; ++i) {
+            new (&shards[i]) Shard(_cap);
+        }
+    }
+
+    ConcurrentHashTable(const ConcurrentHashTable&) = delete;
+    ConcurrentHashTable& operator=(const ConcurrentHashTable&) = delete;
+
+    ~ConcurrentHashTable() {
+        for (int i = 0; i < shard_count; ++i) {
+            shards[i].~Shard();
+        }
+        ::operator delete(shards, std::align_val_t(alignof(Shard)));
+    }
+
+    //si la llave existe reemplaza el valor y conserva su posicion en el orden de insercion
+    void insert(const TK& key, const TV& value) {
+        Shard& shard = shard_of(key);
+        std::unique_lock<std::shared_mutex> g(shard.lock);
+        auto res = shard.table.try_emplace(key, value, 0ULL);
+        if (res.second) res.first->second.seq = shard.sequence++;
+        else res.first->second.value = value;
+    }
+
+    void insert(const pair<TK, TV>& item) {
+        insert(item.first, item.second);
+    }
+
+    //devuelve una copia: una referencia podria invalidarse por otro hilo
+    TV at(const TK& key) const {
+        Shard& shard = shard_of(key);
+        std::shared_lock<std::shared_mutex> g(shard.lock);
+        return shard.table.at(key).value;
+    }
+
+    bool find(const TK& key) const {
+        Shard& shard = shard_of(key);
+        std::shared_lock<std::shared_mutex> g(shard.lock);
+        return shard.table.find(key);
+    }
+
+    bool remove(const TK& key) {
+        Shard& shard = shard_of(key);
+        std::unique_lock<std::shared_mutex> g(shard.lock);
+        return shard.table.remove(key);
+    }
+
+    int getSize() const {
+        int total = 0;
+        for (int i = 0; i < shard_count; ++i) {
+            std::shared_lock<std::shared_mutex> g(shards[i].lock);
+            total += shards[i].table.getSize();
+        }
+        return total;
+    }
+
+    /*orden de (secuencia, shard): dentro de cada shard es el orden de insercion, y los
+      shards se intercalan por posicion. Cada shard se lee con su lock, asi que no es
+      una foto atomica de toda la tabla*/
+    vector<TK> getAllKeys() const {
+        vector<TK> keys;
+        collect([&](const pair<TK, TV>& item) { keys.push_back(item.first); });
+        return keys;
+    }
+
+    vector<pair<TK, TV>> getAllElements() const {
+        vector<pair<TK, TV>> elements;
+        collect([&](const pair<TK, TV>& item) { elements.push_back(item); });
+        return elements;
+    }
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+// Epoch-based reclamation shared by every lock-free structure in the process.
+//
+// Readers wrap each access in an EpochGuard, which publishes the global epoch
+// in the thread's slot. A writer that unlinks memory records the epoch at that
+// moment and may free it once the global epoch has advanced twice: by then
+// every reader that could still hold a pointer to it has left. The epoch only
+// advances when all active readers have seen the current one.
+class EpochDomain {
+public:
+    static const int MaxThreads = 256;
+    static const unsigned long long Idle = ~0ULL;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<unsigned long long> epoch{Idle};
+        std::atomic<bool> taken{false};
+    };
+
+    // one per thread, released when the thread exits
+    struct Registration {
+        int index = -1;
+        int depth = 0;
+
+        ~Registration() {
+            if (index >= 0) {
+                EpochDomain& d = instance();
+                d.slots[index].epoch.store(Idle);
+                d.slots[index].taken.store(false);
+            }
+        }
+    };
+
+    std::atomic<unsigned long long> global{2};
+    Slot slots[MaxThreads];
+
+    EpochDomain() = default;
+
+    static Registration& registration() {
+        static thread_local Registration r;
+        return r;
+    }
+
+    int claim_slot() {
+        for (int i = 0; i < MaxThreads; ++i) {
+            bool expected = false;
+            if (!slots[i].taken.load() && slots[i].taken.compare_exchange_strong(expected, true)) {
+                return i;
+            }
+        }
+        throw std::runtime_error("EpochDomain: too many reader threads");
+    }
+
+public:
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    void enter() {
+        Registration& r = registration();
+        if (r.index < 0) r.index = claim_slot();
+        if (r.depth++ == 0) {
+            slots[r.index].epoch.store(global.load());
+            // pairs with the fence in try_advance: either the writer sees this
+            // slot or this reader sees everything unlinked before the scan
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void exit() {
+        Registration& r = registration();
+        if (--r.depth == 0) {
+            slots[r.index].epoch.store(Idle);
+        }
+    }
+
+    unsigned long long epoch() const {
+        return global.load();
+    }
+
+    // Advances the global epoch if every active reader has caught up with it
+    bool try_advance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        unsigned long long e = global.load();
+        for (int i = 0; i < MaxThreads; ++i) {
+            if (!slots[i].taken.load()) continue;
+            unsigned long long seen = slots[i].epoch.load();
+            if (seen != Idle && seen != e) return false;
+        }
+        return global.compare_exchange_strong(e, e + 1);
+    }
+
+    // Memory retired at `retired` can no longer be reached by any reader
+    bool reclaimable(unsigned long long retired) const {
+        return global.load() >= retired + 2;
+    }
+};
+
+class EpochGuard {
+public:
+    EpochGuard() {
+        EpochDomain::instance().enter();
+    }
+
+    ~EpochGuard() {
+        EpochDomain::instance().exit();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+// Memory unlinked by writers that share one lock, in retirement order. Each
+// entry remembers the epoch it was retired in and is freed once no reader
+// can still hold it. Whatever remains is freed with the list, so it must
+// outlive every reader of the structure that owns it.
+class RetireList {
+    struct Retired {
+        void* ptr;
+        void (*dispose)(void*);
+        unsigned long long epoch;
+        Retired* next;
+    };
+
+    Retired* head;
+    Retired* tail;
+
+    void pop() {
+        Retired* r = head;
+        head = r->next;
+        if (head == nullptr) tail = nullptr;
+        r->dispose(r->ptr);
+        delete r;
+    }
+
+public:
+    RetireList() : head(nullptr), tail(nullptr) {
+    }
+
+    RetireList(const RetireList&) = delete;
+    RetireList& operator=(const RetireList&) = delete;
+
+    ~RetireList() {
+        while (head != nullptr) pop();
+    }
+
+    template<typename T>
+    void retire(T* ptr) {
+        Retired* r = new Retired{ptr, [](void* p) { delete static_cast<T*>(p); },
+                                 EpochDomain::instance().epoch(), nullptr};
+        if (tail == nullptr) head = r;
+        else tail->next = r;
+        tail = r;
+    }
+
+    // Entries are in epoch order, so freeing stops at the first live one
+    void reclaim() {
+        EpochDomain& domain = EpochDomain::instance();
+        domain.try_advance();
+        while (head != nullptr && domain.reclaimable(head->epoch)) pop();
+    }
+};
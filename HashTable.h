@@ -1,9 +1,190 @@
+#pragma once
+
 #include <iostream>
+#include <new>
+#include <utility>
+#include <stdexcept>
+#include <memory>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <iterator>
+#include "Stats.h"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 using namespace std;
 
-const int maxColision = 3;
+//factor de carga maximo por defecto (slots ocupados + tumbas) antes de redimensionar
+const double maxLoadFactor = 0.875;
+//entradas que migra cada operacion mientras dura un rehash incremental
+const int rehashStep = 4;
+//entradas muertas que puede saltar un paso de migracion por cada entrada que mueve (como en Redis)
+const int rehashEmptyVisits = 10;
+//llaves que las operaciones por lotes hashean y prefetchean antes de resolverlas
+const int batchWindow = 32;
+//entradas que una tabla chica guarda dentro del objeto, sin memoria dinamica, y bytes que ese
+//buffer puede ocupar: lo pagan todas las tablas, tambien las que ya crecieron
+const int inlineEntries = 8;
+const size_t inlineBytes = 256;
+
+//ocupa lo mismo que la entrada de HashTable: el par y su hash
+template <typename TK, typename TV>
+struct EntryLayout {
+    pair<TK, TV> kv;
+    size_t hash;
+};
 
+//entradas inline por defecto: inlineEntries mientras quepan en inlineBytes, 0 si no cabe ni una
 template <typename TK, typename TV>
+constexpr int defaultInlineEntries() {
+    return static_cast<int>(std::min<size_t>(inlineEntries, inlineBytes / sizeof(EntryLayout<TK, TV>)));
+}
+
+//politicas de capacidad: como se reduce el hash a un indice y como crece el arreglo
+struct PowerOfTwoPolicy {
+    static size_t index(size_t h, int cap) {
+        return h & static_cast<size_t>(cap - 1);
+    }
+    static int nextCapacity(int n) {
+        int cap = 1;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+};
+
+struct PrimePolicy {
+    static size_t index(size_t h, int cap) {
+        return h % static_cast<size_t>(cap);
+    }
+    static int nextCapacity(int n) {
+        if (n < 2) return 2;
+        while (!isPrime(n)) ++n;
+        return n;
+    }
+    static bool isPrime(int n) {
+        if (n < 2) return false;
+        for (int d = 2; d * d <= n; ++d) {
+            if (n % d == 0) return false;
+        }
+        return true;
+    }
+};
+
+//hasher por defecto; para string es transparente y acepta string_view o const char* sin crear un string
+template <typename TK>
+struct DefaultHash : std::hash<TK> {};
+
+template <>
+struct DefaultHash<std::string> {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+template <typename TK>
+struct DefaultKeyEqual : std::equal_to<TK> {};
+
+template <>
+struct DefaultKeyEqual<std::string> : std::equal_to<> {};
+
+//grupos de bytes de control que el sondeo compara de una vez: match(c) devuelve un bit por byte
+//igual a c y available() uno por byte libre (EMPTY o DELETED, los unicos negativos)
+struct ScalarCtrlGroup {
+    static constexpr int Width = 16;
+    static constexpr const char* name = "scalar";
+    const signed char* bytes;
+    explicit ScalarCtrlGroup(const signed char* p) : bytes(p) {}
+    unsigned match(signed char c) const {
+        unsigned mask = 0;
+        for (int i = 0; i < Width; ++i) mask |= static_cast<unsigned>(bytes[i] == c) << i;
+        return mask;
+    }
+    unsigned available() const {
+        unsigned mask = 0;
+        for (int i = 0; i < Width; ++i) mask |= static_cast<unsigned>(bytes[i] < 0) << i;
+        return mask;
+    }
+};
+
+#if defined(__SSE2__)
+struct Sse2CtrlGroup {
+    static constexpr int Width = 16;
+    static constexpr const char* name = "sse2";
+    __m128i bytes;
+    explicit Sse2CtrlGroup(const signed char* p) : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+    unsigned match(signed char c) const {
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(c))));
+    }
+    unsigned available() const {
+        return static_cast<unsigned>(_mm_movemask_epi8(bytes));
+    }
+};
+#endif
+
+//AVX2 compara 32 bytes. Si el binario no se compila para AVX2 (AED_NATIVE) se elige en tiempo
+//de ejecucion segun la CPU; el sondeo se instancia una vez por grupo y flatten mete el grupo
+//dentro de la copia AVX2, que de otro modo llamaria a match() en cada paso
+#if defined(__AVX2__)
+#define AED_CTRL_AVX2 __attribute__((always_inline))
+#elif defined(__SSE2__) && defined(__x86_64__) && defined(__GNUC__)
+#define AED_CTRL_AVX2 __attribute__((target("avx2"), flatten))
+#define AED_CTRL_DISPATCH
+#endif
+
+#if defined(AED_CTRL_AVX2)
+struct Avx2CtrlGroup {
+    static constexpr int Width = 32;
+    static constexpr const char* name = "avx2";
+    const signed char* bytes;
+    explicit Avx2CtrlGroup(const signed char* p) : bytes(p) {}
+    AED_CTRL_AVX2 unsigned match(signed char c) const {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes));
+        return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))));
+    }
+    AED_CTRL_AVX2 unsigned available() const {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes));
+        return static_cast<unsigned>(_mm256_movemask_epi8(v));
+    }
+};
+#endif
+
+//AED_SCALAR_PROBE fuerza el grupo escalar, para comparar
+#if defined(AED_SCALAR_PROBE)
+typedef ScalarCtrlGroup DefaultCtrlGroup;
+#undef AED_CTRL_DISPATCH
+#elif defined(__AVX2__)
+typedef Avx2CtrlGroup DefaultCtrlGroup;
+#elif defined(__SSE2__)
+typedef Sse2CtrlGroup DefaultCtrlGroup;
+#else
+typedef ScalarCtrlGroup DefaultCtrlGroup;
+#endif
+
+#if defined(AED_CTRL_DISPATCH)
+inline bool cpuHasAvx2() {
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+#endif
+
+//nombre del grupo que usan las busquedas en esta CPU
+inline const char* ctrlGroupName() {
+#if defined(AED_CTRL_DISPATCH)
+    if (cpuHasAvx2()) return Avx2CtrlGroup::name;
+#endif
+    return DefaultCtrlGroup::name;
+}
+
+template <typename TK, typename TV, typename Hash = DefaultHash<TK>, typename KeyEqual = DefaultKeyEqual<TK>,
+          typename Allocator = std::allocator<pair<const TK, TV>>, typename Policy = PowerOfTwoPolicy,
+          typename Stats = NoStats, int InlineEntries = defaultInlineEntries<TK, TV>()>
 class HashTable;
 
 namespace std {
@@ -13,242 +194,938 @@ namespace std {
 }
 
 //itera sobre el hashtable manteniendo el orden de insercion
-template <typename TK, typename TV>
+template <typename Table>
 class HashIterator {
 private:
-    HashTable<TK, TV>* hashtable;
-    typename HashTable<TK, TV>::Node* current;
+    Table* hashtable;
+    int current;
 
 public:
-    HashIterator(HashTable<TK,TV>* ht,
-                 typename HashTable<TK,TV>::Node* node)
-      : hashtable(ht), current(node) {}
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename Table::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef value_type* pointer;
+    typedef value_type& reference;
+
+    HashIterator() : hashtable(nullptr), current(-1) {}
+    HashIterator(Table* ht, int ref)
+      : hashtable(ht), current(ref) {}
 
-    bool operator!=(const HashIterator<TK, TV>& other) const {
+    bool operator==(const HashIterator<Table>& other) const {
+        return current == other.current;
+    }
+    bool operator!=(const HashIterator<Table>& other) const {
         return current != other.current;
     }
-    HashIterator<TK, TV>& operator++() {
-        if (current) current = current->next;
+    HashIterator<Table>& operator++() {
+        if (current != -1) current = hashtable->next(current);
         return *this;
     }
-    pair<TK, TV> operator*() {
-        return {current->key, hashtable->at(current->key)};
+    HashIterator<Table> operator++(int) {
+        HashIterator<Table> prev = *this;
+        ++*this;
+        return prev;
+    }
+    //referencia al par guardado en la entrada, sin copias ni una segunda busqueda
+    typename Table::value_type& operator*() const {
+        return hashtable->entry(current).kv;
+    }
+    typename Table::value_type* operator->() const {
+        return &hashtable->entry(current).kv;
     }
 };
 
-template <typename TK, typename TV>
+template <typename TK, typename TV, typename Hash, typename KeyEqual, typename Allocator, typename Policy,
+          typename Stats, int InlineEntries>
 class HashTable
 {
 public:
-    typedef HashIterator<TK, TV>  iterator;
-    friend class HashIterator<TK, TV>;
-    iterator begin() { return iterator(this, list_head); }
-    iterator end() { return iterator(this, nullptr); }
+    typedef TK key_type;
+    typedef TV mapped_type;
+    typedef pair<const TK, TV> value_type;
+    typedef HashIterator<HashTable>  iterator;
+    friend class HashIterator<HashTable>;
+    iterator begin() { return iterator(this, seek(table.gen, 0)); }
+    iterator end() { return iterator(this, -1); }
 
 private:
-    struct Node {
-        TK key;
-        Node* prev;
-        Node* next;
-        Node(TK k) : key(k), prev(nullptr), next(nullptr) {}
-    };
+    //bytes de control: un slot lleno guarda los 7 bits altos de su hash (0..127)
+    static const signed char EMPTY = -128;
+    static const signed char DELETED = -2;
+    //bit de generacion de una referencia: distingue el arreglo actual del viejo durante una migracion
+    static const int GEN = 1 << 30;
+    //bytes EMPTY despues del ultimo slot, para que un grupo se pueda leer desde cualquier slot
+    static const int CTRL_PAD = 32;
+    //hash de una entrada borrada; hash_of nunca lo devuelve
+    static const size_t DEAD = ~static_cast<size_t>(0);
 
+    //el par vive en un arreglo denso de entradas en orden de insercion, junto a su hash completo,
+    //que no se vuelve a calcular. Una entrada borrada destruye su par y queda con hash DEAD
+    //hasta que el siguiente rehash compacta el arreglo
     struct Entry {
-        TK key;
-        TV value;
-        Node* list_node;
-        Entry(TK k, TV v, Node* ln) : key(k), value(v), list_node(ln) {}
+        //el iterador expone kv con la llave const; al migrar se mueve por mutable_kv, que tiene
+        //el mismo layout (el mismo truco que usan las implementaciones de unordered_map)
+        union {
+            value_type kv;
+            pair<TK, TV> mutable_kv;
+        };
+        size_t hash;
+        struct Dead {};
+        template <typename... Args>
+        Entry(size_t h, Args&&... args) : kv(std::forward<Args>(args)...), hash(h) {}
+        Entry(Entry&& other) : mutable_kv(std::move(other.mutable_kv)), hash(other.hash) {}
+        explicit Entry(Dead) : hash(DEAD) {}
+        ~Entry() { kv.~value_type(); }
+        //una entrada muerta no se vuelve a destruir
+        void kill() {
+            kv.~value_type();
+            hash = DEAD;
+        }
     };
 
-    struct Bucket {
-        struct BucketEntry {
-            Entry* entry;
-            BucketEntry* next;
-            BucketEntry(Entry* e, BucketEntry* n = nullptr) : entry(e), next(n) {}
-        };
-        BucketEntry* head;
-        int count;
+    static_assert(sizeof(Entry) == sizeof(EntryLayout<TK, TV>), "defaultInlineEntries mide mal la entrada");
 
-        Bucket() : head(nullptr), count(0) {}
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Entry> EntryAllocator;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<signed char> CtrlAllocator;
+    typedef std::allocator_traits<EntryAllocator> EntryTraits;
+    typedef std::allocator_traits<CtrlAllocator> CtrlTraits;
+
+    //ctrl e index son por slot: el tag del slot y el numero de la entrada que lo ocupa, en tantos
+    //bytes como hagan falta para numerar capacity entradas (1, 2 o 4)
+    struct Table {
+        signed char* ctrl;
+        unsigned char* index;
+        Entry* entries;
+        int capacity;
+        int width;
+        int used;//slots llenos + tumbas, determina cuando redimensionar
+        int count;//slots llenos
+        int entries_cap;
+        int entries_used;//entradas agregadas, vivas o muertas
+        int gen;//0 o GEN, se alterna en cada rehash
+        Table() : ctrl(nullptr), index(nullptr), entries(nullptr), capacity(0), width(1), used(0), count(0),
+                  entries_cap(0), entries_used(0), gen(0) {}
     };
 
-    Bucket* buckets;
-    int capacity;//capacidad del hash table
+    //Una tabla chica no tiene slots (capacity == 0): sus entradas viven en inline_buf y se buscan
+    //recorriendolas. Al pasar de InlineEntries se mudan a un arreglo con slots, como en un rehash.
+    //Una tabla chica nunca migra, asi que inline_buf comparte lugar con old; el resto del buffer
+    //(InlineEntries * sizeof(Entry) - sizeof(Table)) lo pagan tambien las tablas grandes. Por
+    //defecto se acota a inlineBytes; con InlineEntries = 0 no pagan nada
+    Table table;
+    union {
+        Table old;//arreglo que se esta vaciando, capacity == 0 si no hay migracion
+        alignas(Entry) unsigned char inline_buf[InlineEntries > 0 ? sizeof(Entry) * InlineEntries : 1];
+    };
+    int rehash_idx;//siguiente entrada de old por migrar
+    //las entradas migradas se compactan en table.entries[0, moved); lo insertado durante la
+    //migracion va desde reserved, las vivas que tenia old al empezar
+    int moved;
+    int reserved;
     int size;//total de elementos
-    Node* list_head;
-    Node* list_tail;
+    double max_load;
+    bool incremental;
+    int step;//entradas migradas por operacion
+    Hash hasher;
+    KeyEqual key_equal;
+    EntryAllocator entry_alloc;
+    CtrlAllocator ctrl_alloc;
+    //con NoStats no ocupa espacio y sus llamadas desaparecen al compilar
+    [[no_unique_address]] mutable Stats stats;
 
-    size_t hash(TK key) const {
-        return std::hash<TK>{}(key) % capacity;
+    static size_t mix(size_t h) {
+        //std::hash<int> es la identidad, se mezclan los bits para repartir indice y tag
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
     }
 
+    template <typename K>
+    size_t hash_of(const K& key) const {
+        size_t h = mix(hasher(key));
+        return h == DEAD ? h - 1 : h;
+    }
 
-public:
-    HashTable(int _cap = 5) : capacity(_cap), size(0), list_head(nullptr), list_tail(nullptr) {
-        buckets = new Bucket[capacity];
+    static signed char tag(size_t h) {
+        return static_cast<signed char>(h >> (sizeof(size_t) * 8 - 7));
     }
-    ~HashTable() {
-        delete[] buckets;
-        Node* current = list_head;
-        while (current) {
-            Node* next = current->next;
-            delete current;
-            current = next;
-        }
-    }
-    void insert(TK key, TV value) {
-        // Si ya existe, actualizar y salir
-        if (find(key)) {
-            at(key) = value;
-            return;
-        }
 
-        // Antes de insertar, comprobamos si ese bucket excede maxColision
-        size_t idx = hash(key);
-        if (buckets[idx].count >= maxColision) {
-            rehashing();
-            idx = std::hash<TK>{}(key) % capacity;
+    static int width_for(int entries) {
+        return entries <= (1 << 8) ? 1 : entries <= (1 << 16) ? 2 : 4;
+    }
+
+    //numero de la entrada del slot i
+    static int entry_at(const Table& t, int i) {
+        if (t.width == 1) return t.index[i];
+        if (t.width == 2) {
+            uint16_t e;
+            std::memcpy(&e, t.index + 2 * i, 2);
+            return e;
         }
+        uint32_t e;
+        std::memcpy(&e, t.index + 4 * static_cast<size_t>(i), 4);
+        return static_cast<int>(e);
+    }
 
-        // 2.1) añadimos un Node al final de la lista de inserción
-        Node* ln = new Node(key);
-        if (!list_head) {
-            list_head = list_tail = ln;
+    static void set_entry(Table& t, int i, int e) {
+        if (t.width == 1) {
+            t.index[i] = static_cast<unsigned char>(e);
+        } else if (t.width == 2) {
+            uint16_t v = static_cast<uint16_t>(e);
+            std::memcpy(t.index + 2 * i, &v, 2);
         } else {
-            list_tail->next = ln;
-            ln->prev        = list_tail;
-            list_tail      = ln;
+            uint32_t v = static_cast<uint32_t>(e);
+            std::memcpy(t.index + 4 * static_cast<size_t>(i), &v, 4);
         }
+    }
 
-        // 2.2) creamos la Entry y la encadenamos en el bucket idx
-        Entry* entry = new Entry(key, value, ln);
-        auto& bucket = buckets[idx];
-        auto be_new   = new typename Bucket::BucketEntry(entry, bucket.head);
-        bucket.head  = be_new;
-        bucket.count += 1;
+    //una referencia es el numero de la entrada mas el bit de generacion de su arreglo
+    Entry& entry(int ref) {
+        Table& t = (ref & GEN) == table.gen ? table : old;
+        return t.entries[ref & ~GEN];
+    }
 
-        // 2.3) ajustamos tamaño total
-        size += 1;
-    };
-    void insert(pair<TK, TV> item) {
-        insert(item.first, item.second);
-    };
-    TV& at(TK key) {
-        int idx = hash(key);
-        auto& bucket = buckets[idx];
-        auto be = bucket.head;
-        while (be) {
-            if (be->entry->key == key) return be->entry->value;
-            be = be->next;
+    //en una tabla chica old no esta activo: sus bytes son los de inline_buf
+    bool migrating() const {
+        return !small() && old.capacity != 0;
+    }
+
+    bool small() const {
+        return table.capacity == 0;
+    }
+
+    //busqueda en una tabla chica: con tan pocas entradas comparar llaves cuesta menos que
+    //calcular el hash, que solo se calcula para guardar una entrada nueva
+    template <typename K>
+    int scan(const K& key) const {
+        for (int e = 0; e < table.entries_used; ++e) {
+            const Entry& en = table.entries[e];
+            if (en.hash != DEAD && key_equal(en.kv.first, key)) return e;
+        }
+        return -1;
+    }
+
+    //referencia de la primera entrada viva en t.entries[p, end), o -1
+    static int seek_in(const Table& t, int p, int end) {
+        for (; p < end; ++p) {
+            if (t.entries[p].hash != DEAD) return p | t.gen;
+        }
+        return -1;
+    }
+
+    //primera entrada viva desde la posicion p del arreglo de generacion gen, en orden de insercion.
+    //Durante una migracion ese orden es: table.entries[0, moved), lo que falta migrar de old y
+    //lo insertado despues, table.entries[reserved, ...)
+    int seek(int gen, int p) const {
+        if (!migrating()) return seek_in(table, p, table.entries_used);
+        int ref;
+        if (gen == table.gen && p < reserved) {
+            if ((ref = seek_in(table, p, moved)) != -1) return ref;
+            gen = old.gen;
+            p = rehash_idx;
+        }
+        if (gen == old.gen) {
+            if ((ref = seek_in(old, std::max(p, rehash_idx), old.entries_used)) != -1) return ref;
+            p = reserved;
+        }
+        return seek_in(table, std::max(p, reserved), table.entries_used);
+    }
+
+    int next(int ref) const {
+        return seek(ref & GEN, (ref & ~GEN) + 1);
+    }
+
+    //bits de las primeras n posiciones de un grupo
+    static unsigned prefix(int n) {
+        return n >= 32 ? ~0u : (1u << n) - 1;
+    }
+
+    //la entrada del slot i de t tiene hash h y llave key
+    template <typename K>
+    bool holds(const Table& t, int i, const K& key, size_t h) const {
+        const Entry& e = t.entries[entry_at(t, i)];
+        return e.hash == h && key_equal(e.kv.first, key);
+    }
+
+    //sondeo lineal por grupos: se detiene en el primer EMPTY, las tumbas se saltan.
+    //Un grupo compara todos sus tags de una vez y solo los que coinciden pasan a comparar
+    //el hash completo y la llave; un grupo que cruza el final del arreglo se corta ahi
+    template <typename Group, typename K>
+    int probe(const Table& t, const K& key, size_t h) const {
+        signed char tg = tag(h);
+        int home = static_cast<int>(Policy::index(h, t.capacity));
+        int idx = home;
+        //el slot de origen se prueba antes con un salto: en un grupo su posicion saldria de la
+        //mascara, y la CPU no podria adelantar la lectura de la entrada mientras llega el control
+        if (t.ctrl[idx] == tg && holds(t, idx, key, h)) {
+            stats.probe(0);
+            return idx;
+        }
+        for (int probed = 0; probed < t.capacity; ) {
+            Group g(t.ctrl + idx);
+            int span = std::min(Group::Width, t.capacity - idx);
+            unsigned valid = prefix(span);
+            unsigned empty = g.match(EMPTY) & valid;
+            unsigned hits = g.match(tg) & valid;
+            if (empty) hits &= (empty & (0u - empty)) - 1;
+            for (; hits; hits &= hits - 1) {
+                int i = idx + __builtin_ctz(hits);
+                if (holds(t, i, key, h)) {
+                    stats.probe(distance(t, home, i));
+                    return i;
+                }
+            }
+            if (empty) {
+                stats.probe(distance(t, home, idx + __builtin_ctz(empty)));
+                return -1;
+            }
+            probed += span;
+            idx += span;
+            if (idx == t.capacity) idx = 0;
+        }
+        stats.probe(t.capacity);
+        return -1;
+    }
+
+    //slots recorridos desde el de origen hasta i, dando la vuelta al arreglo
+    static int distance(const Table& t, int home, int i) {
+        return i >= home ? i - home : i + t.capacity - home;
+    }
+
+#if defined(AED_CTRL_DISPATCH)
+    template <typename K>
+    AED_CTRL_AVX2 int probe_avx2(const Table& t, const K& key, size_t h) const {
+        return probe<Avx2CtrlGroup>(t, key, h);
+    }
+#endif
+
+    template <typename K>
+    int find_slot(const Table& t, const K& key, size_t h) const {
+#if defined(AED_CTRL_DISPATCH)
+        if (cpuHasAvx2()) return probe_avx2(t, key, h);
+#endif
+        return probe<DefaultCtrlGroup>(t, key, h);
+    }
+
+    static int find_insert_slot(const Table& t, size_t h) {
+        int idx = static_cast<int>(Policy::index(h, t.capacity));
+        for (;;) {
+            DefaultCtrlGroup g(t.ctrl + idx);
+            int span = std::min(DefaultCtrlGroup::Width, t.capacity - idx);
+            unsigned open = g.available() & prefix(span);
+            if (open) return idx + __builtin_ctz(open);
+            idx += span;
+            if (idx == t.capacity) idx = 0;
+        }
+    }
+
+    //busca en el arreglo actual y, si hay migracion en curso, tambien en el viejo
+    template <typename K>
+    int lookup(const K& key, size_t h) {
+        if (small()) {
+            int e = scan(key);
+            return e == -1 ? -1 : e | table.gen;
+        }
+        int idx = find_slot(table, key, h);
+        if (idx != -1) return entry_at(table, idx) | table.gen;
+        if (migrating()) {
+            idx = find_slot(old, key, h);
+            if (idx != -1) return entry_at(old, idx) | old.gen;
+        }
+        return -1;
+    }
+
+    //cap slots y lugar para entries entradas
+    void allocate(Table& t, int cap, int entries) {
+        t.capacity = cap;
+        t.used = t.count = t.entries_used = 0;
+        t.entries_cap = entries;
+        t.width = width_for(cap);
+        t.ctrl = CtrlTraits::allocate(ctrl_alloc, cap + CTRL_PAD);
+        for (int i = 0; i < cap + CTRL_PAD; ++i) t.ctrl[i] = EMPTY;
+        t.index = reinterpret_cast<unsigned char*>(CtrlTraits::allocate(ctrl_alloc, index_bytes(t)));
+        t.entries = EntryTraits::allocate(entry_alloc, t.entries_cap);
+    }
+
+    //cada entrada ocupa un slot, asi que no pueden ser mas que los slots que permite max_load
+    int entries_for(int cap) const {
+        return std::min(cap, static_cast<int>(cap * max_load) + 1);
+    }
+
+    /*entradas del arreglo nuevo de un rehash. Sin rehash incremental empieza con la mitad mas
+      de las vivas y crece despues por su cuenta (grow_entries), sin tocar los slots: justo
+      despues de duplicar los slots la mitad de entries_for quedaria vacia. Con rehash
+      incremental se reserva todo de una vez, para que ningun insert mueva todas las entradas*/
+    int entries_after_rehash(int new_cap) const {
+        if (incremental) return entries_for(new_cap);
+        return std::min(entries_for(new_cap), size + size / 2 + 1);
+    }
+
+    //las entradas se acabaron antes que los slots: se agranda solo su arreglo, salvo que la
+    //mitad sean entradas muertas, que un rehash compacta
+    bool grow_entries() {
+        int limit = entries_for(table.capacity);
+        if (incremental || table.entries_cap >= limit || table.used + 1 > table.capacity * max_load ||
+            (table.entries_used - size) * 2 > table.entries_used) {
+            return false;
+        }
+        resize_entries(table, std::min(limit, table.entries_cap + table.entries_cap / 2 + 1));
+        return true;
+    }
+
+    //cambia el arreglo de entradas de t por uno de n, sin cambiar sus numeros
+    void resize_entries(Table& t, int n) {
+        Entry* entries = EntryTraits::allocate(entry_alloc, n);
+        for (int e = 0; e < t.entries_used; ++e) {
+            Entry& src = t.entries[e];
+            if (src.hash == DEAD) {
+                EntryTraits::construct(entry_alloc, &entries[e], typename Entry::Dead());
+            } else {
+                EntryTraits::construct(entry_alloc, &entries[e], std::move(src));
+                EntryTraits::destroy(entry_alloc, &src);
+            }
+        }
+        EntryTraits::deallocate(entry_alloc, t.entries, t.entries_cap);
+        t.entries = entries;
+        t.entries_cap = n;
+    }
+
+    static size_t index_bytes(const Table& t) {
+        return static_cast<size_t>(t.capacity) * t.width;
+    }
+
+    void release(Table& t) {
+        if (t.ctrl) CtrlTraits::deallocate(ctrl_alloc, t.ctrl, t.capacity + CTRL_PAD);
+        if (t.index) CtrlTraits::deallocate(ctrl_alloc, reinterpret_cast<signed char*>(t.index), index_bytes(t));
+        if (t.entries) EntryTraits::deallocate(entry_alloc, t.entries, t.entries_cap);
+        t.ctrl = nullptr;
+        t.index = nullptr;
+        t.entries = nullptr;
+        t.capacity = t.used = t.count = t.entries_cap = t.entries_used = 0;
+    }
+
+    //destruye las entradas vivas de t.entries[p, end)
+    void destroy_entries(Table& t, int p, int end) {
+        for (; p < end; ++p) {
+            if (t.entries[p].hash != DEAD) EntryTraits::destroy(entry_alloc, &t.entries[p]);
         }
-        throw std::out_of_range("Key not found in HashTable::at()");
     }
 
-    TV& operator[](TK key) {
-        try {
-            return at(key);
-        } catch (out_of_range&) {
-            insert(key, TV());
-            return at(key);
+    //pide a la cache el control y el indice del slot de origen de h, la busqueda empieza por ahi
+    static void prefetch_home(const Table& t, size_t h) {
+        if (t.capacity == 0) return;
+        size_t idx = Policy::index(h, t.capacity);
+        __builtin_prefetch(t.ctrl + idx);
+        __builtin_prefetch(t.index + idx * t.width);
+    }
+
+    static int claim(Table& t, size_t h) {
+        int idx = find_insert_slot(t, h);
+        if (t.ctrl[idx] == EMPTY) t.used++;
+        t.ctrl[idx] = tag(h);
+        t.count++;
+        return idx;
+    }
+
+    static void vacate(Table& t, int idx) {
+        //si el siguiente slot esta vacio ninguna cadena de sondeo pasa por aqui, no hace falta tumba
+        int next = idx + 1 == t.capacity ? 0 : idx + 1;
+        if (t.ctrl[next] == EMPTY) {
+            t.ctrl[idx] = EMPTY;
+            t.used--;
+        } else {
+            t.ctrl[idx] = DELETED;
         }
+        t.count--;
     }
 
-    bool find(TK key) {
-        int idx = hash(key);
-        auto& bucket = buckets[idx];
-        auto be = bucket.head;
-        while (be) {
-            if (be->entry->key == key) return true;
-            be = be->next;
+public:
+    HashTable(int _cap = 5, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(),
+              const Allocator& alloc = Allocator())
+      : rehash_idx(0), moved(0), reserved(0), size(0), max_load(maxLoadFactor),
+        incremental(false), step(rehashStep), hasher(hash), key_equal(equal),
+        entry_alloc(alloc), ctrl_alloc(alloc) {
+        //una capacidad pedida de hasta inlineEntries empieza en el buffer aunque este tenga menos
+        //lugar (entradas grandes): mudarse despues cuesta lo mismo que reservar ahora
+        if (InlineEntries > 0 && _cap <= std::max(InlineEntries, inlineEntries)) {
+            table.entries = reinterpret_cast<Entry*>(inline_buf);
+            table.entries_cap = InlineEntries;
+        } else {
+            old = Table();
+            int cap = Policy::nextCapacity(_cap < 1 ? 1 : _cap);
+            allocate(table, cap, entries_for(cap));
         }
-        return false;
+    }
+    HashTable(const HashTable&) = delete;
+    HashTable& operator=(const HashTable&) = delete;
+    ~HashTable() {
+        if (migrating()) {
+            destroy_entries(old, rehash_idx, old.entries_used);
+            destroy_entries(table, 0, moved);
+            destroy_entries(table, reserved, table.entries_used);
+            release(old);
+        } else {
+            destroy_entries(table, 0, table.entries_used);
+        }
+        if (!small()) release(table);
+    }
+    void insert(const TK& key, const TV& value) {
+        insert_or_assign(key, value);
+    }
+    void insert(TK&& key, TV&& value) {
+        insert_or_assign(std::move(key), std::move(value));
+    }
+    void insert(const pair<TK, TV>& item) {
+        insert_or_assign(item.first, item.second);
+    }
+    void insert(pair<TK, TV>&& item) {
+        insert_or_assign(std::move(item.first), std::move(item.second));
     }
 
-    bool remove(TK key) {
-        int idx = hash(key);
-        auto& bucket = buckets[idx];
-        typename Bucket::BucketEntry* prev = nullptr;
-        auto current = bucket.head;
+    /*si la llave existe reemplaza el valor, si no la agrega al final del orden de insercion*/
+    template <typename M>
+    pair<iterator, bool> insert_or_assign(const TK& key, M&& obj) {
+        auto res = emplace_ref(key, std::forward<M>(obj));
+        if (!res.second) entry(res.first).kv.second = std::forward<M>(obj);
+        return {iterator(this, advance(res.first)), res.second};
+    }
+    template <typename M>
+    pair<iterator, bool> insert_or_assign(TK&& key, M&& obj) {
+        auto res = emplace_ref(std::move(key), std::forward<M>(obj));
+        if (!res.second) entry(res.first).kv.second = std::forward<M>(obj);
+        return {iterator(this, advance(res.first)), res.second};
+    }
 
-        while (current) {
-            if (current->entry->key == key) {
-                if (prev) prev->next = current->next;
-                else bucket.head = current->next;
+    /*si la llave existe no hace nada (ni mueve los argumentos), si no construye el valor con args*/
+    template <typename... Args>
+    pair<iterator, bool> try_emplace(const TK& key, Args&&... args) {
+        auto res = emplace_ref(key, std::forward<Args>(args)...);
+        return {iterator(this, advance(res.first)), res.second};
+    }
+    template <typename... Args>
+    pair<iterator, bool> try_emplace(TK&& key, Args&&... args) {
+        auto res = emplace_ref(std::move(key), std::forward<Args>(args)...);
+        return {iterator(this, advance(res.first)), res.second};
+    }
 
-                Entry* entry = current->entry;
-                Node* list_node = entry->list_node;
+    /*construye el par con args; si la llave ya existe el par se descarta*/
+    template <typename... Args>
+    pair<iterator, bool> emplace(Args&&... args) {
+        pair<TK, TV> item(std::forward<Args>(args)...);
+        return try_emplace(std::move(item.first), std::move(item.second));
+    }
 
-                if (list_node->prev) list_node->prev->next = list_node->next;
-                else list_head = list_node->next;
-                if (list_node->next) list_node->next->prev = list_node->prev;
-                else list_tail = list_node->prev;
+    TV& at(const TK& key) {
+        return at_ref(key);
+    }
 
-                delete list_node;
-                delete entry;
-                delete current;
+    TV& operator[](const TK& key) {
+        return entry(advance(emplace_ref(key).first)).kv.second;
+    }
+    TV& operator[](TK&& key) {
+        return entry(advance(emplace_ref(std::move(key)).first)).kv.second;
+    }
 
-                bucket.count--;
-                size--;
-                return true;
+    bool find(const TK& key) {
+        return find_ref(key) != -1;
+    }
+
+    bool remove(const TK& key) {
+        return remove_ref(key);
+    }
+
+    /*found[i] indica si keys[i] esta. Las llaves se procesan en bloques: primero se calculan
+      los hashes del bloque y se piden sus slots a la cache, despues se resuelven, asi las
+      esperas a memoria de llaves distintas se solapan en vez de encadenarse*/
+    void find_many(const TK* keys, int n, bool* found) {
+        lookup_many(keys, n, [&](int i, int ref) { found[i] = ref != -1; });
+    }
+
+    /*values[i] apunta al valor de keys[i], como la referencia que devuelve at().
+      Si falta una llave lanza out_of_range; las posiciones anteriores ya quedan escritas*/
+    void at_many(const TK* keys, int n, TV** values) {
+        lookup_many(keys, n, [&](int i, int ref) {
+            if (ref == -1) throw std::out_of_range("Key not found in HashTable::at_many()");
+            values[i] = &entry(ref).kv.second;
+        });
+    }
+
+    /*inserta n pares con la semantica de insert (el ultimo valor de una llave repetida gana);
+      la tabla crece como maximo una vez por llamada*/
+    void insert_many(const pair<TK, TV>* items, int n) {
+        //a lo sumo un rehash: rehashing() duplica la capacidad, lo que deja lugar para otros tantos
+        //elementos, y si el lote no cabe ni asi se reserva para todo el de una vez
+        if (n > size + 2) reserve(size + n);
+        size_t hashes[batchWindow];
+        for (int base = 0; base < n; base += batchWindow) {
+            int m = std::min(batchWindow, n - base);
+            if (migrating()) rehash_step(step * m);
+            for (int j = 0; j < m; ++j) {
+                hashes[j] = hash_of(items[base + j].first);
+                prefetch_home(table, hashes[j]);
+            }
+            for (int j = 0; j < m; ++j) {
+                const pair<TK, TV>& item = items[base + j];
+                auto res = emplace_hashed(hashes[j], item.first, item.second);
+                if (!res.second) entry(res.first).kv.second = item.second;
+            }
+        }
+    }
+
+    /*deja espacio para n elementos: hasta entonces insertar no redimensiona. Si hace falta
+      crecer, el rehash se completa aqui aunque el rehash incremental este activo*/
+    void reserve(int n) {
+        if (small()) {
+            if (n > table.entries_cap) spill(capacity_for(n + 1));
+            else if (table.entries_used + (n - size) > table.entries_cap) compact_inline();
+            return;
+        }
+        if (migrating()) finish_rehash();
+        if (table.used + (n - size) + 1 <= table.capacity * max_load) {
+            int need = table.entries_used + (n - size) + 1;
+            if (need <= table.entries_cap) return;
+            if (need <= entries_for(table.capacity)) {
+                resize_entries(table, need);
+                return;
             }
-            prev = current;
-            current = current->next;
         }
-        return false;
+        int new_cap = capacity_for(n + 1);
+        start_rehash(new_cap, entries_for(new_cap));
+        finish_rehash();
+    }
+
+    /*busqueda heterogenea (p.ej. string_view o const char* cuando TK es string),
+      solo disponible si Hash y KeyEqual declaran is_transparent*/
+    template <typename K, typename H = Hash, typename Eq = KeyEqual,
+              typename = typename H::is_transparent, typename = typename Eq::is_transparent>
+    TV& at(const K& key) {
+        return at_ref(key);
+    }
+
+    template <typename K, typename H = Hash, typename Eq = KeyEqual,
+              typename = typename H::is_transparent, typename = typename Eq::is_transparent>
+    bool find(const K& key) {
+        return find_ref(key) != -1;
+    }
+
+    template <typename K, typename H = Hash, typename Eq = KeyEqual,
+              typename = typename H::is_transparent, typename = typename Eq::is_transparent>
+    bool remove(const K& key) {
+        return remove_ref(key);
     }
 
     int getSize() { return size; }
 
+    /*slots del arreglo, o las entradas que caben dentro del objeto mientras la tabla es chica*/
+    int getCapacity() { return small() ? table.entries_cap : table.capacity; }
+
+    double getLoadFactor() { return static_cast<double>(size) / getCapacity(); }
+
+    double getMaxLoadFactor() { return max_load; }
+
+    /*el sondeo abierto necesita al menos un slot vacio, por eso el limite es < 1*/
+    void setMaxLoadFactor(double lf) {
+        if (lf <= 0 || lf >= 1) {
+            throw invalid_argument("Max load factor must be in (0, 1)");
+        }
+        max_load = lf;
+        //con un limite mayor y rehash incremental el arreglo de entradas tiene que alcanzar para
+        //los slots que se permiten; sin el, grow_entries lo agranda cuando haga falta
+        if (incremental && entries_for(table.capacity) > table.entries_cap) {
+            finish_rehash();
+            resize_entries(table, entries_for(table.capacity));
+        }
+    }
+
+    /*si esta activo, el rehash reparte la migracion entre las siguientes operaciones*/
+    void setIncrementalRehash(bool enabled) {
+        incremental = enabled;
+        if (!incremental) finish_rehash();
+    }
+
+    /*cota de entradas que cada insert/find/at/remove migra durante un rehash incremental*/
+    void setRehashStep(int n) {
+        if (n < 1) {
+            throw invalid_argument("Rehash step must be positive");
+        }
+        step = n;
+    }
+
+    bool isRehashing() { return migrating(); }
+
+    /*estadisticas de la politica Stats (ver Stats.h): largo de los sondeos, rehashes y su
+      duracion, y latencia de insert/find/at/remove de una llave. Las operaciones por lotes
+      solo cuentan sus sondeos*/
+    const Stats& getStats() const { return stats; }
+
+    void resetStats() { stats = Stats(); }
+
     /*itera sobre el hashtable manteniendo el orden de insercion*/
     vector<TK> getAllKeys() {
         vector<TK> keys;
-        Node* current = list_head;
-        while (current) {
-            keys.push_back(current->key);
-            current = current->next;
+        keys.reserve(size);
+        for (auto it = begin(); it != end(); ++it) {
+            keys.push_back(it->first);
         }
         return keys;
     }
 
     vector<pair<TK, TV>> getAllElements() {
         vector<pair<TK, TV>> elements;
-        Node* current = list_head;
-        while (current) {
-            elements.push_back({current->key, at(current->key)});
-            current = current->next;
+        elements.reserve(size);
+        for (auto it = begin(); it != end(); ++it) {
+            elements.push_back(*it);
         }
         return elements;
     }
 private:
-    /*Si una lista colisionada excede maxColision, redimensionar el array*/
+    /*la llave y los argumentos de una operacion pueden ser de una entrada de la tabla
+      (insert(k, at(otra)), remove(it->first)), y un paso de migracion mueve y libera entradas.
+      Por eso el paso se da al final, con advance, cuando ya no se usan; ref sigue a su entrada
+      si el paso la muda*/
+    int advance(int ref = -1) {
+        if (migrating()) rehash_step(step, &ref);
+        return ref;
+    }
+
+    /*busca la llave y, si no esta, construye el valor con args al final del orden de insercion.
+      Devuelve la referencia de la entrada y si hubo insercion; el llamador da el paso de migracion*/
+    template <typename K, typename... Args>
+    pair<int, bool> emplace_ref(K&& key, Args&&... args) {
+        auto timer = stats.time(StatOp::Insert);
+        if (small()) {
+            int e = scan(key);
+            if (e != -1) return {e | table.gen, false};
+            return emplace_new(hash_of(key), std::forward<K>(key), std::forward<Args>(args)...);
+        }
+        size_t h = hash_of(key);
+        return emplace_hashed(h, std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    //emplace_ref con el hash ya calculado
+    template <typename K, typename... Args>
+    pair<int, bool> emplace_hashed(size_t h, K&& key, Args&&... args) {
+        int ref = lookup(key, h);
+        if (ref != -1) return {ref, false};
+        return emplace_new(h, std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    /*agrega una llave que no esta. Si hay que crecer, el rehash mueve y libera las entradas de
+      las que pueden venir key y args: el par se arma aparte antes, como en vector::push_back*/
+    template <typename K, typename... Args>
+    pair<int, bool> emplace_new(size_t h, K&& key, Args&&... args) {
+        // Antes de insertar, comprobamos que el factor de carga no exceda max_load
+        if (!needs_growth()) {
+            return place(h, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+        Entry item(h, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                   std::forward_as_tuple(std::forward<Args>(args)...));
+        rehashing();
+        return place(h, std::move(item.mutable_kv));
+    }
+
+    //construye el par de la entrada con args al final del arreglo, que ya tiene lugar
+    template <typename... Args>
+    pair<int, bool> place(size_t h, Args&&... args) {
+        int e = table.entries_used;
+        EntryTraits::construct(entry_alloc, &table.entries[e], h, std::forward<Args>(args)...);
+        table.entries_used++;
+        if (!small()) set_entry(table, claim(table, h), e);
+        size++;
+        return {e | table.gen, true};
+    }
+
+    template <typename K>
+    int find_ref(const K& key) {
+        auto timer = stats.time(StatOp::Find);
+        if (small()) {
+            int e = scan(key);
+            return e == -1 ? -1 : e | table.gen;
+        }
+        return advance(lookup(key, hash_of(key)));
+    }
+
+    //busqueda por bloques de batchWindow llaves; emit(i, ref) recibe -1 si keys[i] no esta.
+    //La migracion de todo el lote se hace antes: un paso posterior moveria entradas ya devueltas
+    template <typename Fun>
+    void lookup_many(const TK* keys, int n, Fun emit) {
+        if (migrating()) rehash_step(n >= old.count / step ? old.entries_used : step * n);
+        size_t hashes[batchWindow];
+        for (int base = 0; base < n; base += batchWindow) {
+            int m = std::min(batchWindow, n - base);
+            for (int j = 0; j < m; ++j) {
+                hashes[j] = hash_of(keys[base + j]);
+                prefetch_home(table, hashes[j]);
+            }
+            for (int j = 0; j < m; ++j) emit(base + j, lookup(keys[base + j], hashes[j]));
+        }
+    }
+
+    template <typename K>
+    TV& at_ref(const K& key) {
+        int ref = find_ref(key);
+        if (ref == -1) throw std::out_of_range("Key not found in HashTable::at()");
+        return entry(ref).kv.second;
+    }
+
+    //la entrada queda muerta en su lugar y el slot se libera; el orden de las demas no cambia
+    template <typename K>
+    bool remove_ref(const K& key) {
+        auto timer = stats.time(StatOp::Remove);
+        if (small()) {
+            int e = scan(key);
+            if (e == -1) return false;
+            table.entries[e].kill();
+            //la ultima entrada se recupera enseguida, las demas al compactar
+            if (e == table.entries_used - 1) table.entries_used--;
+            size--;
+            return true;
+        }
+        size_t h = hash_of(key);
+        Table* t = &table;
+        int idx = find_slot(table, key, h);
+        if (idx == -1 && migrating()) {
+            t = &old;
+            idx = find_slot(old, key, h);
+        }
+        if (idx != -1) {
+            t->entries[entry_at(*t, idx)].kill();
+            vacate(*t, idx);
+            size--;
+        }
+        advance();
+        return idx != -1;
+    }
+
+    //las entradas pendientes de old tambien terminaran en table
+    bool needs_growth() const {
+        if (small()) return table.entries_used == table.entries_cap;
+        return table.used + old.count + 1 > table.capacity * max_load || table.entries_used == table.entries_cap;
+    }
+
+    /*Si el factor de carga excede max_load o no quedan entradas libres, rehacer los arreglos.
+      Si la mayoria de slots usados son tumbas o entradas muertas basta con compactar sin crecer*/
     void rehashing() {
-        int new_cap = capacity * 2;
-        Bucket* new_buckets = new Bucket[new_cap];
+        if (small()) {
+            if (size < table.entries_cap) compact_inline();
+            //con menos de inlineEntries inline (entradas grandes) se muda igual que con inlineEntries,
+            //para no rehacer el arreglo apenas despues
+            else spill(std::max(capacity_for(size + 1), Policy::nextCapacity(2 * inlineEntries)));
+            return;
+        }
+        if (migrating()) {
+            finish_rehash();
+            if (!needs_growth()) return;
+        }
+        if (grow_entries()) return;
+        int new_cap = grown_capacity();
+        start_rehash(new_cap, entries_after_rehash(new_cap));
+        if (!incremental) finish_rehash();
+    }
 
-        for (int i = 0; i < capacity; ++i) {
-            auto current = buckets[i].head;
-            while (current) {
-                Entry* entry = current->entry;
+    //una duplicacion si los elementos vivos pasan de la mitad de lo que permite max_load; si no,
+    //la misma capacidad y el rehash solo limpia tumbas y entradas muertas
+    int grown_capacity() const {
+        int new_cap = table.capacity;
+        if ((size + 1) * 2 > new_cap * max_load) new_cap = Policy::nextCapacity(new_cap * 2);
+        return std::max(new_cap, capacity_for(size + 1));
+    }
 
-                size_t raw_hash = std::hash<TK>{}(entry->key);
-                int new_idx = raw_hash % new_cap;
+    //la capacidad actual, o la que resulta de duplicarla hasta que n slots usados no pasen de max_load
+    int capacity_for(int n) const {
+        int new_cap = table.capacity;
+        while (n > new_cap * max_load) {
+            new_cap = Policy::nextCapacity(new_cap * 2);
+        }
+        return new_cap;
+    }
 
-                auto& new_bucket = new_buckets[new_idx];
-                auto new_be = new typename Bucket::BucketEntry(entry, new_bucket.head);
-                new_bucket.head = new_be;
-                new_bucket.count++;
+    //el arreglo actual pasa a ser old y sus entradas vivas se migran, compactadas, a uno nuevo
+    //de new_cap slots y entries entradas
+    void start_rehash(int new_cap, int entries) {
+        old = table;
+        allocate(table, new_cap, entries);
+        table.gen = old.gen ^ GEN;
+        rehash_idx = 0;
+        moved = 0;
+        reserved = old.count;
+        table.entries_used = reserved;
+        stats.rehash_begin();
+    }
 
-                auto old_be = current;
-                current = current->next;
-                delete old_be;
+    //junta las entradas vivas de una tabla chica al principio, en el mismo orden
+    void compact_inline() {
+        int live = 0;
+        for (int e = 0; e < table.entries_used; ++e) {
+            Entry& src = table.entries[e];
+            if (src.hash == DEAD) continue;
+            if (e != live) {
+                EntryTraits::construct(entry_alloc, &table.entries[live], std::move(src));
+                src.kill();
             }
-            buckets[i].head = nullptr;
+            live++;
         }
+        table.entries_used = live;
+    }
 
-        delete[] buckets;
-        buckets = new_buckets;
-        capacity = new_cap;
+    //muda las entradas de una tabla chica a un arreglo de new_cap slots; son pocas, se hace de una vez
+    void spill(int new_cap) {
+        Table small_table = table;
+        allocate(table, new_cap, entries_for(new_cap));
+        table.gen = small_table.gen;
+        for (int e = 0; e < small_table.entries_used; ++e) {
+            Entry& src = small_table.entries[e];
+            if (src.hash == DEAD) continue;
+            int p = table.entries_used++;
+            EntryTraits::construct(entry_alloc, &table.entries[p], std::move(src));
+            EntryTraits::destroy(entry_alloc, &src);
+            set_entry(table, claim(table, table.entries[p].hash), p);
         }
-};
+        //las entradas venian de inline_buf, recien ahora old puede ocupar su lugar
+        old = Table();
+    }
+
+    void finish_rehash() {
+        while (migrating()) rehash_step(old.entries_used);
+    }
+
+    /*mueve hasta n entradas vivas de old a table en orden de insercion. Un arreglo con muchas
+      entradas muertas no debe bloquear la operacion, asi que tambien se limita la cantidad
+      de entradas muertas visitadas*/
+    void rehash_step(int n, int* follow = nullptr) {
+        migrate(n, follow);
+        if (old.count == 0) {
+            //quedan los lugares reservados para las entradas que se borraron antes de migrar
+            for (int e = moved; e < reserved; ++e) {
+                EntryTraits::construct(entry_alloc, &table.entries[e], typename Entry::Dead());
+            }
+            release(old);
+            stats.rehash_end();
+        }
+    }
 
+    //lo que tarda cada paso se acumula en el rehash en curso. Los slots de old no se tocan:
+    //la entrada migrada queda muerta y ninguna busqueda en old la vuelve a aceptar. Si *follow es
+    //la referencia de una entrada migrada pasa a ser la de su nuevo lugar
+    void migrate(int n, int* follow) {
+        auto timer = stats.time(StatOp::Rehash);
+        long long dead_visits = static_cast<long long>(n) * rehashEmptyVisits;
+        while (n > 0 && rehash_idx < old.entries_used) {
+            Entry& src = old.entries[rehash_idx++];
+            if (src.hash == DEAD) {
+                if (--dead_visits == 0) break;
+                continue;
+            }
 
+            int e = moved++;
+            EntryTraits::construct(entry_alloc, &table.entries[e], std::move(src));
+            src.kill();
+            set_entry(table, claim(table, table.entries[e].hash), e);
+            if (follow && *follow == ((rehash_idx - 1) | old.gen)) *follow = e | table.gen;
+            old.count--;
+            n--;
+        }
+    }
+};
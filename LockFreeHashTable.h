@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "Epoch.h"
+#include "HashTable.h"
+
+//hashtable para cargas de muchas lecturas: find/at no toman ningun lock.
+//Cada bucket es una lista de entradas inmutables; los escritores (serializados por un mutex)
+//publican entradas y arreglos de buckets nuevos con stores atomicos, y lo que desenlazan
+//se libera recien cuando ningun lector puede seguir viendolo (reclamacion por epocas, Epoch.h).
+template <typename TK, typename TV, typename Hash = DefaultHash<TK>, typename KeyEqual = DefaultKeyEqual<TK>>
+class LockFreeHashTable
+{
+private:
+    //una entrada nunca cambia despues de publicarse: actualizar un valor es reemplazar la entrada
+    struct Entry {
+        const TK key;
+        const TV value;
+        const size_t hash;
+        const unsigned long long seq;//orden de insercion, se conserva al actualizar
+        std::atomic<Entry*> next;
+
+        Entry(const TK& k, const TV& v, size_t h, unsigned long long s, Entry* n)
+            : key(k), value(v), hash(h), seq(s), next(n) {}
+    };
+
+    struct Buckets {
+        size_t mask;
+        std::atomic<Entry*>* heads;
+
+        explicit Buckets(size_t n) : mask(n - 1), heads(new std::atomic<Entry*>[n]) {
+            for (size_t i = 0; i < n; ++i) heads[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        //libera el arreglo junto con las entradas que siguen enlazadas en el
+        ~Buckets() {
+            for (size_t i = 0; i <= mask; ++i) {
+                Entry* e = heads[i].load(std::memory_order_relaxed);
+                while (e != nullptr) {
+                    Entry* next = e->next.load(std::memory_order_relaxed);
+                    delete e;
+                    e = next;
+                }
+            }
+            delete[] heads;
+        }
+    };
+
+    std::atomic<Buckets*> buckets;
+    std::atomic<int> count;
+    unsigned long long sequence;
+    RetireList retired;//lo desenlazado espera a que pasen dos epocas
+    std::mutex write_lock;
+    Hash hasher;
+    KeyEqual key_equal;
+
+    static size_t mix(size_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    size_t hash_of(const TK& key) const {
+        return mix(hasher(key));
+    }
+
+    //solo se llama dentro de un EpochGuard
+    const Entry* lookup(const TK& key) const {
+        size_t h = hash_of(key);
+        Buckets* b = buckets.load(std::memory_order_acquire);
+        Entry* e = b->heads[h & b->mask].load(std::memory_order_acquire);
+        while (e != nullptr) {
+            if (e->hash == h && key_equal(e->key, key)) return e;
+            e = e->next.load(std::memory_order_acquire);
+        }
+        return nullptr;
+    }
+
+    //copia todas las entradas a un arreglo del doble de tamaño y lo publica de una vez;
+    //los lectores que siguen en el arreglo viejo lo ven intacto hasta que se libera
+    void grow() {
+        Buckets* old = buckets.load(std::memory_order_relaxed);
+        Buckets* fresh = new Buckets((old->mask + 1) * 2);
+        for (size_t i = 0; i <= old->mask; ++i) {
+            Entry* e = old->heads[i].load(std::memory_order_relaxed);
+            while (e != nullptr) {
+                std::atomic<Entry*>& head = fresh->heads[e->hash & fresh->mask];
+                head.store(new Entry(e->key, e->value, e->hash, e->seq, head.load(std::memory_order_relaxed)),
+                           std::memory_order_relaxed);
+                e = e->next.load(std::memory_order_relaxed);
+            }
+        }
+        buckets.store(fresh, std::memory_order_release);
+        retired.retire(old);
+    }
+
+    template <typename Fun>
+    void collect(Fun emit) const {
+        std::vector<const Entry*> entries;
+        EpochGuard guard;
+        Buckets* b = buckets.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= b->mask; ++i) {
+            Entry* e = b->heads[i].load(std::memory_order_acquire);
+            while (e != nullptr) {
+                entries.push_back(e);
+                e = e->next.load(std::memory_order_acquire);
+            }
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry* a, const Entry* b) { return a->seq < b->seq; });
+        for (const Entry* e : entries) emit(e->key, e->value);
+    }
+
+public:
+    //_cap se redondea a potencia de dos; el arreglo se duplica cuando hay mas entradas que buckets
+    explicit LockFreeHashTable(int _cap = 8) : count(0), sequence(0) {
+        buckets.store(new Buckets(PowerOfTwoPolicy::nextCapacity(_cap < 2 ? 2 : _cap)));
+    }
+
+    LockFreeHashTable(const LockFreeHashTable&) = delete;
+    LockFreeHashTable& operator=(const LockFreeHashTable&) = delete;
+
+    //no puede haber lectores activos sobre la tabla al destruirla
+    ~LockFreeHashTable() {
+        delete buckets.load();
+    }
+
+    //si la llave existe reemplaza la entrada y conserva su posicion en el orden de insercion
+    void insert(const TK& key, const TV& value) {
+        std::lock_guard<std::mutex> g(write_lock);
+        size_t h = hash_of(key);
+        Buckets* b = buckets.load(std::memory_order_relaxed);
+        std::atomic<Entry*>* link = &b->heads[h & b->mask];
+        Entry* e = link->load(std::memory_order_relaxed);
+        while (e != nullptr) {
+            if (e->hash == h && key_equal(e->key, key)) {
+                link->store(new Entry(e->key, value, h, e->seq, e->next.load(std::memory_order_relaxed)),
+                            std::memory_order_release);
+                retired.retire(e);
+                retired.reclaim();
+                return;
+            }
+            link = &e->next;
+            e = link->load(std::memory_order_relaxed);
+        }
+
+        if (static_cast<size_t>(count.load(std::memory_order_relaxed)) + 1 > b->mask + 1) {
+            grow();
+            b = buckets.load(std::memory_order_relaxed);
+        }
+        std::atomic<Entry*>& head = b->heads[h & b->mask];
+        head.store(new Entry(key, value, h, sequence++, head.load(std::memory_order_relaxed)),
+                   std::memory_order_release);
+        count.fetch_add(1, std::memory_order_relaxed);
+        retired.reclaim();
+    }
+
+    void insert(const pair<TK, TV>& item) {
+        insert(item.first, item.second);
+    }
+
+    bool remove(const TK& key) {
+        std::lock_guard<std::mutex> g(write_lock);
+        size_t h = hash_of(key);
+        Buckets* b = buckets.load(std::memory_order_relaxed);
+        std::atomic<Entry*>* link = &b->heads[h & b->mask];
+        Entry* e = link->load(std::memory_order_relaxed);
+        while (e != nullptr) {
+            if (e->hash == h && key_equal(e->key, key)) {
+                //un lector parado en e sigue viendo su next, que sigue vivo
+                link->store(e->next.load(std::memory_order_relaxed), std::memory_order_release);
+                count.fetch_sub(1, std::memory_order_relaxed);
+                retired.retire(e);
+                retired.reclaim();
+                return true;
+            }
+            link = &e->next;
+            e = link->load(std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    bool find(const TK& key) const {
+        EpochGuard guard;
+        return lookup(key) != nullptr;
+    }
+
+    //busca y copia el valor en un solo paso; find seguido de at podria ver un remove en medio
+    bool find(const TK& key, TV& value) const {
+        EpochGuard guard;
+        const Entry* e = lookup(key);
+        if (e == nullptr) return false;
+        value = e->value;
+        return true;
+    }
+
+    //devuelve una copia: la entrada puede liberarse apenas termina la lectura
+    TV at(const TK& key) const {
+        EpochGuard guard;
+        const Entry* e = lookup(key);
+        if (e == nullptr) throw out_of_range("Key not found in LockFreeHashTable::at()");
+        return e->value;
+    }
+
+    int getSize() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    int getCapacity() const {
+        EpochGuard guard;
+        return static_cast<int>(buckets.load(std::memory_order_acquire)->mask + 1);
+    }
+
+    /*orden de insercion, sin locks. Si hay escritores concurrentes cada entrada es consistente
+      pero el conjunto no es una foto atomica de la tabla*/
+    vector<TK> getAllKeys() const {
+        vector<TK> keys;
+        collect([&](const TK& key, const TV&) { keys.push_back(key); });
+        return keys;
+    }
+
+    vector<pair<TK, TV>> getAllElements() const {
+        vector<pair<TK, TV>> elements;
+        collect([&](const TK& key, const TV& value) { elements.push_back({key, value}); });
+        return elements;
+    }
+};
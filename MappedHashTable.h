@@ -0,0 +1,426 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "HashTable.h"
+
+//como se guarda un campo (llave o valor) en el archivo: los tipos trivialmente copiables
+//van tal cual y se leen por referencia; un string se lee como string_view sin copiarlo, y
+//sus bytes van dentro de la entrada si son pocos (como el SSO de std::string) o en el blob
+//de bytes del archivo si no
+template <typename T>
+struct MappedField {
+    static_assert(std::is_trivially_copyable<T>::value, "MappedHashTable stores trivially copyable types or string");
+    typedef T stored;
+    typedef const T& view;
+    static size_t blob_size(const T&) { return 0; }
+    static stored store(const T& value, char*, uint64_t&) { return value; }
+    static view load(const stored& s, const char*, uint64_t) { return s; }
+};
+
+template <>
+struct MappedField<std::string> {
+    static const size_t INLINE = 16;
+    struct stored {
+        uint64_t size;
+        union {
+            uint64_t offset;
+            char bytes[INLINE];
+        };
+    };
+    typedef std::string_view view;
+    static size_t blob_size(const std::string& value) { return value.size() > INLINE ? value.size() : 0; }
+    //copia los bytes a la entrada o al final del blob
+    static stored store(const std::string& value, char* blob, uint64_t& blob_end) {
+        stored s;
+        std::memset(&s, 0, sizeof(s));
+        s.size = value.size();
+        if (value.size() <= INLINE) {
+            std::memcpy(s.bytes, value.data(), value.size());
+        } else {
+            s.offset = blob_end;
+            std::memcpy(blob + blob_end, value.data(), value.size());
+            blob_end += value.size();
+        }
+        return s;
+    }
+    //un string que sale del blob solo puede venir de un archivo corrupto: se lanza en vez de
+    //leer fuera del mapeo
+    static view load(const stored& s, const char* blob, uint64_t blob_size) {
+        if (s.size <= INLINE) return view(s.bytes, s.size);
+        if (s.offset > blob_size || s.size > blob_size - s.offset) {
+            throw runtime_error("Invalid MappedHashTable entry: string outside the blob");
+        }
+        return view(blob + s.offset, s.size);
+    }
+};
+
+//HashTable de solo lectura servido directamente desde un archivo mapeado en memoria.
+//save() escribe un HashTable en un formato versionado y sin punteros (solo offsets), y el
+//constructor lo mapea con mmap sin deserializar nada: abrir un archivo de varios GB es casi
+//instantaneo, las paginas se cargan a medida que se tocan y los procesos que mapean el mismo
+//archivo comparten su cache de paginas.
+//
+//Layout: cabecera | bytes de control (tags de 7 bits, como HashTable) | entradas, una por slot
+//como los slots de HashTable | slots en orden de insercion | blob con los bytes de los strings.
+//El archivo es portable entre procesos de la misma arquitectura y biblioteca estandar: la
+//cabecera guarda el orden de bytes, los tamaños de los tipos y un hash de control, y el
+//constructor rechaza un archivo que no coincide. Al abrir se validan la cabecera y los limites
+//de las secciones, no cada entrada: recorrerlas haria la apertura O(n). Lo que una entrada
+//apunta (su slot en el orden de insercion, sus bytes en el blob) se valida al leerla, y un
+//archivo corrupto lanza runtime_error en vez de leer fuera del mapeo.
+template <typename TK, typename TV, typename Hash = DefaultHash<TK>, typename KeyEqual = DefaultKeyEqual<TK>>
+class MappedHashTable
+{
+private:
+    typedef MappedField<TK> KeyField;
+    typedef MappedField<TV> ValueField;
+
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t ORDER_MARK = 0x01020304;
+    static constexpr signed char EMPTY = -128;
+    //igual que en HashTable: un grupo se puede leer desde cualquier slot
+    static constexpr int CTRL_PAD = 32;
+
+    struct Entry {
+        uint64_t hash;
+        typename KeyField::stored key;
+        typename ValueField::stored value;
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t key_size;
+        uint32_t value_size;
+        uint32_t entry_size;
+        uint32_t reserved;
+        uint64_t hash_check;//hash de TK() al escribir, detecta un hasher distinto
+        uint64_t count;
+        uint64_t capacity;
+        uint64_t ctrl_offset;
+        uint64_t entries_offset;
+        uint64_t order_offset;
+        uint64_t blob_offset;
+        uint64_t file_size;
+    };
+
+    const char* base;
+    size_t length;
+    const signed char* ctrl;
+    const Entry* entries;
+    const uint32_t* order;
+    const char* blob;
+    uint64_t blob_size;
+    int count;
+    int capacity;
+    Hash hasher;
+    KeyEqual key_equal;
+
+    static size_t mix(size_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    template <typename K>
+    size_t hash_of(const K& key) const {
+        return mix(hasher(key));
+    }
+
+    static signed char tag(size_t h) {
+        return static_cast<signed char>(h >> (sizeof(size_t) * 8 - 7));
+    }
+
+    static uint64_t align(uint64_t offset, uint64_t to) {
+        return (offset + to - 1) / to * to;
+    }
+
+    static void check(bool ok, const std::string& path, const char* what) {
+        if (!ok) throw runtime_error("Invalid MappedHashTable file " + path + ": " + what);
+    }
+
+    //hace durable la entrada de path en su directorio (el rename)
+    static void sync_directory(const std::string& path) {
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        bool ok = fd >= 0 && fsync(fd) == 0;
+        if (fd >= 0) close(fd);
+        if (!ok) throw runtime_error("Cannot sync the directory of MappedHashTable file " + path);
+    }
+
+    //sondeo lineal por grupos sobre un arreglo sin tumbas; devuelve el slot o -1
+    template <typename K>
+    int probe(const K& key) const {
+        size_t h = hash_of(key);
+        signed char tg = tag(h);
+        int idx = static_cast<int>(h & static_cast<size_t>(capacity - 1));
+        //como en HashTable, el slot de origen se prueba antes con un salto que la CPU especula
+        if (ctrl[idx] == tg && matches(entries[idx], key, h)) return idx;
+        for (int probed = 0; probed < capacity; ) {
+            DefaultCtrlGroup g(ctrl + idx);
+            int span = std::min(DefaultCtrlGroup::Width, capacity - idx);
+            unsigned valid = span >= 32 ? ~0u : (1u << span) - 1;
+            unsigned empty = g.match(EMPTY) & valid;
+            unsigned hits = g.match(tg) & valid;
+            if (empty) hits &= (empty & (0u - empty)) - 1;
+            for (; hits; hits &= hits - 1) {
+                int i = idx + __builtin_ctz(hits);
+                if (matches(entries[i], key, h)) return i;
+            }
+            if (empty) return -1;
+            probed += span;
+            idx += span;
+            if (idx == capacity) idx = 0;
+        }
+        return -1;
+    }
+
+    template <typename K>
+    bool matches(const Entry& e, const K& key, size_t h) const {
+        return e.hash == h && key_equal(key_of(e), key);
+    }
+
+    typename KeyField::view key_of(const Entry& e) const {
+        return KeyField::load(e.key, blob, blob_size);
+    }
+
+    typename ValueField::view value_of(const Entry& e) const {
+        return ValueField::load(e.value, blob, blob_size);
+    }
+
+    //la i-esima entrada en orden de insercion
+    const Entry& ordered(int i) const {
+        uint32_t slot = order[i];
+        if (slot >= static_cast<uint32_t>(capacity)) {
+            throw runtime_error("Invalid MappedHashTable entry: insertion order points outside the table");
+        }
+        return entries[slot];
+    }
+
+public:
+    typedef typename KeyField::view key_view;
+    typedef typename ValueField::view value_view;
+
+    //recorre las entradas en orden de insercion
+    class iterator {
+        const MappedHashTable* table;
+        int current;
+    public:
+        iterator(const MappedHashTable* t, int i) : table(t), current(i) {}
+        bool operator==(const iterator& other) const { return current == other.current; }
+        bool operator!=(const iterator& other) const { return current != other.current; }
+        iterator& operator++() {
+            ++current;
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator prev = *this;
+            ++current;
+            return prev;
+        }
+        pair<key_view, value_view> operator*() const {
+            const Entry& e = table->ordered(current);
+            return {table->key_of(e), table->value_of(e)};
+        }
+    };
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, count); }
+
+    /*escribe table en path con el orden de insercion. Se escribe en path.tmp y se renombra,
+      asi un proceso que abre path nunca ve un archivo a medias. El archivo llega al disco antes
+      del rename y el directorio despues: tras una caida path es el archivo viejo o el nuevo
+      completo, nunca uno vacio*/
+    template <typename Allocator, typename Policy, typename Stats, int InlineEntries>
+    static void save(HashTable<TK, TV, Hash, KeyEqual, Allocator, Policy, Stats, InlineEntries>& table, const std::string& path,
+                     const Hash& hasher = Hash()) {
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "AEDHASH", 8);
+        header.version = VERSION;
+        header.byte_order = ORDER_MARK;
+        header.key_size = sizeof(typename KeyField::stored);
+        header.value_size = sizeof(typename ValueField::stored);
+        header.entry_size = sizeof(Entry);
+        header.hash_check = mix(hasher(TK()));
+        header.count = table.getSize();
+        uint64_t cap = 1;
+        while (header.count + 1 > cap * maxLoadFactor) cap <<= 1;
+        header.capacity = cap;
+        uint64_t blob_size = 0;
+        for (auto it = table.begin(); it != table.end(); ++it) {
+            blob_size += KeyField::blob_size(it->first) + ValueField::blob_size(it->second);
+        }
+        header.ctrl_offset = align(sizeof(Header), 64);
+        header.entries_offset = align(header.ctrl_offset + cap + CTRL_PAD, 64);
+        header.order_offset = header.entries_offset + cap * sizeof(Entry);
+        header.blob_offset = header.order_offset + header.count * sizeof(uint32_t);
+        header.file_size = header.blob_offset + blob_size;
+
+        //el archivo se arma dentro de un mapeo escribible: no hace falta una copia en memoria
+        std::string tmp = path + ".tmp";
+        int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw runtime_error("Cannot write MappedHashTable file " + tmp);
+        void* m = MAP_FAILED;
+        if (ftruncate(fd, static_cast<off_t>(header.file_size)) == 0) {
+            m = mmap(nullptr, header.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (m == MAP_FAILED) {
+            close(fd);
+            unlink(tmp.c_str());
+            throw runtime_error("Cannot write MappedHashTable file " + tmp);
+        }
+        char* out = static_cast<char*>(m);
+
+        //ftruncate deja todo en cero; solo hay que escribir lo que no lo es
+        std::memcpy(out, &header, sizeof(header));
+        signed char* ctrl_bytes = reinterpret_cast<signed char*>(out + header.ctrl_offset);
+        std::memset(ctrl_bytes, EMPTY, cap + CTRL_PAD);
+        Entry* slots = reinterpret_cast<Entry*>(out + header.entries_offset);
+        uint32_t* order_slots = reinterpret_cast<uint32_t*>(out + header.order_offset);
+        char* blob_bytes = out + header.blob_offset;
+        uint64_t blob_end = 0;
+        uint32_t n = 0;
+        for (auto it = table.begin(); it != table.end(); ++it, ++n) {
+            size_t h = mix(hasher(it->first));
+            size_t idx = h & (cap - 1);
+            while (ctrl_bytes[idx] != EMPTY) idx = (idx + 1) & (cap - 1);
+            ctrl_bytes[idx] = tag(h);
+            Entry& e = slots[idx];
+            e.hash = h;
+            e.key = KeyField::store(it->first, blob_bytes, blob_end);
+            e.value = ValueField::store(it->second, blob_bytes, blob_end);
+            order_slots[n] = static_cast<uint32_t>(idx);
+        }
+
+        bool ok = msync(m, header.file_size, MS_SYNC) == 0;
+        ok = munmap(m, header.file_size) == 0 && ok;
+        ok = ok && fsync(fd) == 0;
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            unlink(tmp.c_str());
+            throw runtime_error("Cannot write MappedHashTable file " + path);
+        }
+        sync_directory(path);
+    }
+
+    /*mapea path de solo lectura; lanza runtime_error si no existe o no es un archivo valido
+      para estos tipos*/
+    explicit MappedHashTable(const std::string& path, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+      : base(nullptr), length(0), blob_size(0), hasher(hash), key_equal(equal) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Cannot open MappedHashTable file " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+            close(fd);
+            throw runtime_error("Invalid MappedHashTable file " + path + ": too short");
+        }
+        length = static_cast<size_t>(st.st_size);
+        void* m = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (m == MAP_FAILED) throw runtime_error("Cannot map MappedHashTable file " + path);
+        base = static_cast<const char*>(m);
+
+        try {
+            const Header& h = *reinterpret_cast<const Header*>(base);
+            check(std::memcmp(h.magic, "AEDHASH", 8) == 0, path, "bad magic");
+            check(h.version == VERSION, path, "unsupported version");
+            check(h.byte_order == ORDER_MARK, path, "different byte order");
+            check(h.key_size == sizeof(typename KeyField::stored) && h.value_size == sizeof(typename ValueField::stored)
+                  && h.entry_size == sizeof(Entry), path, "different key or value types");
+            check(h.hash_check == mix(hasher(TK())), path, "different hash function");
+            check(h.file_size == length, path, "truncated");
+            check(h.capacity > h.count && (h.capacity & (h.capacity - 1)) == 0 && h.capacity <= (1u << 30),
+                  path, "bad capacity");
+            //cada offset se compara con el largo antes de sumarle algo, asi ninguna suma desborda:
+            //capacity y count ya estan acotados
+            check(h.ctrl_offset >= sizeof(Header) && h.ctrl_offset <= length
+                  && h.entries_offset >= h.ctrl_offset && h.entries_offset <= length
+                  && h.order_offset >= h.entries_offset && h.order_offset <= length
+                  && h.blob_offset >= h.order_offset && h.blob_offset <= length, path, "bad section offsets");
+            check(h.ctrl_offset + h.capacity + CTRL_PAD <= h.entries_offset
+                  && h.entries_offset + h.capacity * sizeof(Entry) <= h.order_offset
+                  && h.order_offset + h.count * sizeof(uint32_t) <= h.blob_offset, path, "sections overlap");
+            check(h.entries_offset % alignof(Entry) == 0 && h.order_offset % alignof(uint32_t) == 0,
+                  path, "misaligned sections");
+            ctrl = reinterpret_cast<const signed char*>(base + h.ctrl_offset);
+            entries = reinterpret_cast<const Entry*>(base + h.entries_offset);
+            order = reinterpret_cast<const uint32_t*>(base + h.order_offset);
+            blob = base + h.blob_offset;
+            blob_size = length - h.blob_offset;
+            count = static_cast<int>(h.count);
+            capacity = static_cast<int>(h.capacity);
+        } catch (...) {
+            munmap(const_cast<char*>(base), length);
+            throw;
+        }
+    }
+
+    MappedHashTable(const MappedHashTable&) = delete;
+    MappedHashTable& operator=(const MappedHashTable&) = delete;
+
+    ~MappedHashTable() {
+        munmap(const_cast<char*>(base), length);
+    }
+
+    bool find(const TK& key) const {
+        return probe(key) != -1;
+    }
+
+    //una vista dentro del archivo (const TV& o string_view), valida mientras la tabla exista
+    value_view at(const TK& key) const {
+        int i = probe(key);
+        if (i == -1) throw out_of_range("Key not found in MappedHashTable::at()");
+        return value_of(entries[i]);
+    }
+
+    /*busqueda heterogenea, igual que en HashTable*/
+    template <typename K, typename H = Hash, typename Eq = KeyEqual,
+              typename = typename H::is_transparent, typename = typename Eq::is_transparent>
+    bool find(const K& key) const {
+        return probe(key) != -1;
+    }
+
+    template <typename K, typename H = Hash, typename Eq = KeyEqual,
+              typename = typename H::is_transparent, typename = typename Eq::is_transparent>
+    value_view at(const K& key) const {
+        int i = probe(key);
+        if (i == -1) throw out_of_range("Key not found in MappedHashTable::at()");
+        return value_of(entries[i]);
+    }
+
+    int getSize() const { return count; }
+
+    int getCapacity() const { return capacity; }
+
+    /*copias en orden de insercion*/
+    vector<TK> getAllKeys() const {
+        vector<TK> keys;
+        keys.reserve(count);
+        for (int i = 0; i < count; ++i) keys.push_back(TK(key_of(ordered(i))));
+        return keys;
+    }
+
+    vector<pair<TK, TV>> getAllElements() const {
+        vector<pair<TK, TV>> elements;
+        elements.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            const Entry& e = ordered(i);
+            elements.push_back({TK(key_of(e)), TV(value_of(e))});
+        }
+        return elements;
+    }
+};
@@ -0,0 +1,286 @@
+#ifndef PersistentAVLTree_H
+#define PersistentAVLTree_H
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "AVL_Node.h"
+#include "AVL_Iterator.h"
+
+using namespace std;
+
+// One immutable version of a PersistentAVLTree. Taking or copying a snapshot
+// is O(1): it only adds a reference to the root. Nodes are freed when the
+// last version holding them goes away, so a snapshot can be read and released
+// on any thread while the writer keeps changing the tree.
+template<typename T>
+class AVLSnapshot {
+protected:
+    using Node = PersistentNodeAVL<T>;
+    // an AVL tree with 2^31 nodes is less than 45 levels high
+    static const int MaxHeight = 64;
+
+    Node *root;
+
+    static Node* share(Node *n) {
+        if (n) n->refs.fetch_add(1, std::memory_order_relaxed);
+        return n;
+    }
+
+    // Drops one reference to n, freeing every node no other version holds
+    static void release(Node *n) {
+        Node* pending[MaxHeight];
+        int top = 0;
+        if (n) pending[top++] = n;
+        while (top > 0) {
+            Node* x = pending[--top];
+            if (x->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+            if (x->left) pending[top++] = x->left;
+            if (x->right) pending[top++] = x->right;
+            delete x;
+        }
+    }
+
+    explicit AVLSnapshot(Node *root) : root(root) {
+    }
+
+public:
+    typedef AVLIterator<T, const Node> iterator;
+
+    AVLSnapshot() : root(nullptr) {
+    }
+
+    AVLSnapshot(const AVLSnapshot& other) : root(share(other.root)) {
+    }
+
+    AVLSnapshot(AVLSnapshot&& other) noexcept : root(other.root) {
+        other.root = nullptr;
+    }
+
+    AVLSnapshot& operator=(AVLSnapshot other) noexcept {
+        std::swap(root, other.root);
+        return *this;
+    }
+
+    ~AVLSnapshot() {
+        release(root);
+    }
+
+    iterator begin(typename iterator::Type type = iterator::InOrder) const {
+        return iterator(root, type);
+    }
+
+    iterator end() const {
+        return iterator(root, iterator::InOrder, true);
+    }
+
+    iterator rbegin() const {
+        return iterator(root, iterator::ReverseInOrder);
+    }
+
+    iterator rend() const {
+        return iterator(root, iterator::ReverseInOrder, true);
+    }
+
+    bool find(const T& value) const {
+        const Node *curr = root;
+        while (curr != nullptr) {
+            if (value < curr->data) curr = curr->left;
+            else if (curr->data < value) curr = curr->right;
+            else return true;
+        }
+        return false;
+    }
+
+    int size() const {
+        return root ? root->size : 0;
+    }
+
+    int height() const {
+        return root ? root->height : -1;
+    }
+
+    T minValue() const {
+        if (!root) throw std::runtime_error("Cannot get min value of nullptr");
+        const Node *n = root;
+        while (n->left) n = n->left;
+        return n->data;
+    }
+
+    T maxValue() const {
+        if (!root) throw std::runtime_error("Cannot get max value of nullptr");
+        const Node *n = root;
+        while (n->right) n = n->right;
+        return n->data;
+    }
+
+    T successor(const T& value) const {
+        const Node *found = nullptr;
+        for (const Node *curr = root; curr != nullptr;) {
+            if (value < curr->data) {
+                found = curr;
+                curr = curr->left;
+            } else {
+                curr = curr->right;
+            }
+        }
+        if (!found) throw invalid_argument("No successor for " + to_string(value) + " value");
+        return found->data;
+    }
+
+    T predecessor(const T& value) const {
+        const Node *found = nullptr;
+        for (const Node *curr = root; curr != nullptr;) {
+            if (curr->data < value) {
+                found = curr;
+                curr = curr->right;
+            } else {
+                curr = curr->left;
+            }
+        }
+        if (!found) throw invalid_argument("No predecessor for " + to_string(value) + " value");
+        return found->data;
+    }
+};
+
+// AVL tree whose versions share structure. insert and remove copy only the
+// O(log n) nodes on the search path that an older version still holds, and
+// change the rest in place, so without live snapshots nothing is copied.
+// Copying the tree is O(1) as well.
+//
+// One thread at a time may change a given tree; snapshot() is taken by that
+// thread and the result may then be handed to any other.
+template<typename T>
+class PersistentAVLTree : public AVLSnapshot<T> {
+    using Node = typename AVLSnapshot<T>::Node;
+    using AVLSnapshot<T>::root;
+    using AVLSnapshot<T>::share;
+    using AVLSnapshot<T>::release;
+
+public:
+    PersistentAVLTree() = default;
+
+    AVLSnapshot<T> snapshot() const {
+        return AVLSnapshot<T>(*this);
+    }
+
+    void insert(const T& value) {
+        // a duplicate must not copy the path
+        if (this->find(value)) return;
+        root = _insert(root, value);
+    }
+
+    void remove(const T& value) {
+        if (!this->find(value)) return;
+        root = _remove(root, value);
+    }
+
+    void clear() {
+        release(root);
+        root = nullptr;
+    }
+
+private:
+    static int height_of(const Node *n) {
+        return n ? n->height : -1;
+    }
+
+    static int size_of(const Node *n) {
+        return n ? n->size : 0;
+    }
+
+    // Returns a node that may be changed in place for this reference to n:
+    // n itself when nothing else holds it, otherwise a copy that takes over
+    // the reference
+    static Node* own(Node *n) {
+        if (n->refs.load(std::memory_order_acquire) == 1) return n;
+        Node* copy = new Node(n->data);
+        copy->left = share(n->left);
+        copy->right = share(n->right);
+        copy->height = n->height;
+        copy->size = n->size;
+        release(n);
+        return copy;
+    }
+
+    static void update(Node *n) {
+        n->height = 1 + std::max(height_of(n->left), height_of(n->right));
+        n->size = 1 + size_of(n->left) + size_of(n->right);
+    }
+
+    static int balancingFactor(const Node *n) {
+        return height_of(n->left) - height_of(n->right);
+    }
+
+    // value is known to be absent
+    Node* _insert(Node *n, const T& value) {
+        if (!n) return new Node(value);
+        n = own(n);
+        if (value < n->data) n->left = _insert(n->left, value);
+        else n->right = _insert(n->right, value);
+        return balance(n);
+    }
+
+    // value is known to be present
+    Node* _remove(Node *n, const T& value) {
+        n = own(n);
+        if (value < n->data) {
+            n->left = _remove(n->left, value);
+        } else if (n->data < value) {
+            n->right = _remove(n->right, value);
+        } else if (!n->left || !n->right) {
+            // the child reference passes to the parent
+            Node* child = n->left ? n->left : n->right;
+            delete n;
+            return child;
+        } else {
+            const Node* predecessor = n->left;
+            while (predecessor->right) predecessor = predecessor->right;
+            n->data = predecessor->data;
+            n->left = _remove(n->left, n->data);
+        }
+        return balance(n);
+    }
+
+    // n is owned; children are taken over before a rotation changes them
+    Node* balance(Node *n) {
+        update(n);
+        int factor = balancingFactor(n);
+        // Left
+        if (factor > 1) {
+            n->left = own(n->left);
+            // LR
+            if (balancingFactor(n->left) < 0) n->left = left_rotate(n->left);
+            return right_rotate(n);
+        }
+        // Right
+        if (factor < -1) {
+            n->right = own(n->right);
+            // RL
+            if (balancingFactor(n->right) > 0) n->right = right_rotate(n->right);
+            return left_rotate(n);
+        }
+        return n;
+    }
+
+    // x must be owned; the child moving up is taken over here
+    static Node* left_rotate(Node *x) {
+        Node* y = x->right = own(x->right);
+        x->right = y->left;
+        y->left = x;
+        update(x);
+        update(y);
+        return y;
+    }
+
+    static Node* right_rotate(Node *x) {
+        Node* y = x->left = own(x->left);
+        x->left = y->right;
+        y->right = x;
+        update(x);
+        update(y);
+        return y;
+    }
+};
+
+#endif //PersistentAVLTree_H
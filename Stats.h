@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+
+//instrumentacion opcional de HashTable y AVLTree, elegida con su ultimo parametro de template.
+//
+//NoStats (por defecto) tiene ganchos inline vacios y un timer vacio: el compilador elimina todas
+//las llamadas y las estructuras compilan como si no los tuvieran. CollectStats registra:
+//  - el largo de los sondeos de HashTable, en slots desde el slot de origen;
+//  - cuantos rehashes hubo y cuanto tardo cada uno en migrar, tambien los incrementales que se
+//    reparten entre muchas operaciones;
+//  - las rotaciones de AVLTree por caso;
+//  - la latencia de cada insert, find y remove de una llave;
+//  - la altura de AVLTree contra log2(n), medida al leer las estadisticas.
+
+enum class StatOp { Insert, Find, Remove, Rehash };
+
+enum class Rotation { LL, LR, RR, RL };
+
+//cuenta valores en buckets de potencias de dos: el bucket 0 guarda el 0 y el bucket b > 0
+//guarda [2^(b-1), 2^b)
+class Histogram {
+public:
+    static constexpr int Buckets = 65;
+
+private:
+    uint64_t buckets[Buckets] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t largest = 0;
+
+public:
+    static int bucket_of(uint64_t v) {
+        return v == 0 ? 0 : 64 - __builtin_clzll(v);
+    }
+
+    //el menor valor que no cabe en el bucket b
+    static uint64_t bucket_limit(int b) {
+        return b >= 64 ? ~0ULL : 1ULL << b;
+    }
+
+    void record(uint64_t v) {
+        buckets[bucket_of(v)]++;
+        total++;
+        sum += v;
+        if (v > largest) largest = v;
+    }
+
+    uint64_t count() const { return total; }
+
+    uint64_t count(int bucket) const { return buckets[bucket]; }
+
+    uint64_t max() const { return largest; }
+
+    double mean() const { return total ? static_cast<double>(sum) / total : 0; }
+
+    //limite superior del bucket donde cae el percentil p, p en [0, 100]; a lo sumo el doble
+    //del valor exacto
+    uint64_t percentile(double p) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * total));
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < Buckets; ++b) {
+            seen += buckets[b];
+            if (seen >= rank) return b == 0 ? 0 : std::min(bucket_limit(b) - 1, largest);
+        }
+        return largest;
+    }
+
+    //escribe "<cantidad> mean <media> p50 <p50> p99 <p99> max <maximo>"
+    void print(std::ostream& out) const {
+        out << total << " mean " << mean() << " p50 " << percentile(50) << " p99 " << percentile(99)
+            << " max " << largest;
+    }
+};
+
+//contador que las operaciones paralelas de AVLTree pueden incrementar desde varios hilos;
+//una copia toma una foto del valor
+class StatCounter {
+    std::atomic<uint64_t> n{0};
+
+public:
+    StatCounter() = default;
+    StatCounter(const StatCounter& other) : n(other.get()) {}
+    StatCounter& operator=(const StatCounter& other) {
+        n.store(other.get(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void add() { n.fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t get() const { return n.load(std::memory_order_relaxed); }
+};
+
+struct NoStats {
+    static constexpr bool enabled = false;
+
+    struct Timer {
+        //con destructor propio, asi un timer que no se usa no genera un warning
+        ~Timer() {}
+    };
+
+    Timer time(StatOp) { return Timer(); }
+    void probe(uint64_t) {}
+    void rehash_begin() {}
+    void rehash_end() {}
+    void rotation(Rotation) {}
+    void shape(int, int) {}
+};
+
+struct CollectStats {
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr bool enabled = true;
+    static constexpr int Ops = 3;
+
+    Histogram probes;
+    Histogram latency_ns[Ops];//indexado por StatOp
+    uint64_t rehashes = 0;
+    Histogram rehash_ns;//una muestra por rehash terminado
+    StatCounter rotations[4];//indexado por Rotation
+    int height = 0;
+    int size = 0;
+
+    class Timer {
+        CollectStats& stats;
+        StatOp op;
+        Clock::time_point start;
+
+    public:
+        Timer(CollectStats& stats, StatOp op) : stats(stats), op(op), start(Clock::now()) {}
+        Timer(const Timer&) = delete;
+        ~Timer() {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            if (op == StatOp::Rehash) stats.migrating_ns += ns;
+            else stats.latency_ns[static_cast<int>(op)].record(ns);
+        }
+    };
+
+    Timer time(StatOp op) { return Timer(*this, op); }
+
+    void probe(uint64_t length) { probes.record(length); }
+
+    void rehash_begin() {
+        rehashes++;
+        migrating_ns = 0;
+    }
+
+    void rehash_end() { rehash_ns.record(migrating_ns); }
+
+    void rotation(Rotation r) { rotations[static_cast<int>(r)].add(); }
+
+    void shape(int h, int n) {
+        height = h;
+        size = n;
+    }
+
+    const Histogram& latency(StatOp op) const { return latency_ns[static_cast<int>(op)]; }
+
+    double log2_size() const { return std::log2(static_cast<double>(size) + 1); }
+
+    //un AVL de n llaves nunca es mas alto que 1.44 log2(n + 2) - 0.328
+    double height_bound() const { return 1.4405 * std::log2(static_cast<double>(size) + 2) - 0.3277; }
+
+    void print(std::ostream& out) const {
+        static const char* const ops[] = {"insert", "find", "remove"};
+        if (probes.count()) {
+            out << "probe length: ";
+            probes.print(out);
+            out << "\n";
+        }
+        if (rehashes) {
+            out << "rehashes: " << rehashes << ", ns per rehash: ";
+            rehash_ns.print(out);
+            out << "\n";
+        }
+        uint64_t ll = rotations[0].get(), lr = rotations[1].get(), rr = rotations[2].get(), rl = rotations[3].get();
+        if (ll + lr + rr + rl) {
+            out << "rotations: LL " << ll << " LR " << lr << " RR " << rr << " RL " << rl << "\n";
+        }
+        if (size) {
+            out << "height: " << height << ", log2(n + 1) " << log2_size() << ", AVL bound "
+                << height_bound() << "\n";
+        }
+        for (int op = 0; op < Ops; ++op) {
+            if (!latency_ns[op].count()) continue;
+            out << ops[op] << " ns: ";
+            latency_ns[op].print(out);
+            out << "\n";
+        }
+    }
+
+private:
+    uint64_t migrating_ns = 0;
+};
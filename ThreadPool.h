@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Fork-join pool with one task deque per thread. A thread pushes the second
+// half of a fork to the bottom of its own deque and runs the first half;
+// idle threads steal from the top of other deques. Waiting threads help by
+// running stolen work, so nested forks never deadlock.
+//
+// Parallel work is entered through run(), which makes the calling thread
+// worker 0; fork_join() called from any other thread simply runs serially.
+// Forked functions must not throw.
+class WorkStealingPool {
+    static const int DequeCapacity = 256;
+
+    struct Task {
+        void (*fn)(void*);
+        void* arg;
+        std::atomic<bool> done;
+    };
+
+    struct Worker {
+        std::mutex lock;
+        Task* tasks[DequeCapacity];
+        int top = 0;    // next task to steal
+        int bottom = 0; // next free slot
+    };
+
+    int count;
+    Worker* workers;
+    std::thread* threads;
+    std::atomic<bool> stopping;
+    std::atomic<int> queued;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    std::mutex entry_lock;
+
+    static inline thread_local WorkStealingPool* tl_pool = nullptr;
+    static inline thread_local int tl_index = -1;
+
+    int current_index() const {
+        return tl_pool == this ? tl_index : -1;
+    }
+
+    bool push(int self, Task* t) {
+        Worker& w = workers[self];
+        {
+            std::lock_guard<std::mutex> g(w.lock);
+            if (w.bottom == DequeCapacity) return false;
+            w.tasks[w.bottom++] = t;
+        }
+        queued.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> g(sleep_lock);
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    // Takes t back if nobody stole it; forks are LIFO so it is at the bottom
+    bool pop(int self, Task* t) {
+        Worker& w = workers[self];
+        std::lock_guard<std::mutex> g(w.lock);
+        if (w.bottom > w.top && w.tasks[w.bottom - 1] == t) {
+            if (--w.bottom == w.top) w.top = w.bottom = 0;
+            queued.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    Task* steal(int victim) {
+        Worker& w = workers[victim];
+        std::lock_guard<std::mutex> g(w.lock);
+        if (w.bottom == w.top) return nullptr;
+        Task* t = w.tasks[w.top++];
+        if (w.top == w.bottom) w.top = w.bottom = 0;
+        queued.fetch_sub(1);
+        return t;
+    }
+
+    // Runs one task stolen from another thread, if any
+    bool help(int self) {
+        for (int i = 1; i <= count; ++i) {
+            int victim = (self + i) % count;
+            Task* t = steal(victim);
+            if (t) {
+                t->fn(t->arg);
+                t->done.store(true, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(int index) {
+        tl_pool = this;
+        tl_index = index;
+        while (!stopping.load()) {
+            if (help(index)) continue;
+            std::unique_lock<std::mutex> lk(sleep_lock);
+            wake.wait_for(lk, std::chrono::milliseconds(10), [this] {
+                return stopping.load() || queued.load() > 0;
+            });
+        }
+    }
+
+public:
+    explicit WorkStealingPool(int threads_count = static_cast<int>(std::thread::hardware_concurrency()))
+        : count(threads_count < 1 ? 1 : threads_count), stopping(false), queued(0) {
+        workers = new Worker[count];
+        threads = new std::thread[count - 1];
+        for (int i = 1; i < count; ++i) {
+            threads[i - 1] = std::thread(&WorkStealingPool::work, this, i);
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        stopping.store(true);
+        {
+            std::lock_guard<std::mutex> g(sleep_lock);
+        }
+        wake.notify_all();
+        for (int i = 0; i < count - 1; ++i) threads[i].join();
+        delete[] threads;
+        delete[] workers;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    // Runs f on the calling thread as worker 0 of this pool
+    template<typename F>
+    void run(F&& f) {
+        if (current_index() >= 0) {
+            f();
+            return;
+        }
+        std::lock_guard<std::mutex> g(entry_lock);
+        WorkStealingPool* prev_pool = tl_pool;
+        int prev_index = tl_index;
+        tl_pool = this;
+        tl_index = 0;
+        f();
+        tl_pool = prev_pool;
+        tl_index = prev_index;
+    }
+
+    template<typename F1, typename F2>
+    void fork_join(F1&& f1, F2&& f2) {
+        int self = current_index();
+        if (self < 0 || count == 1) {
+            f1();
+            f2();
+            return;
+        }
+
+        using Fn = typename std::remove_reference<F2>::type;
+        Task t;
+        t.fn = [](void* p) { (*static_cast<Fn*>(p))(); };
+        t.arg = const_cast<void*>(static_cast<const void*>(&f2));
+        t.done.store(false, std::memory_order_relaxed);
+
+        bool pushed = push(self, &t);
+        f1();
+        if (!pushed || pop(self, &t)) {
+            f2();
+            return;
+        }
+        while (!t.done.load(std::memory_order_acquire)) {
+            if (!help(self)) std::this_thread::yield();
+        }
+    }
+};
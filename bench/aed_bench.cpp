@@ -0,0 +1,356 @@
+// Benchmark suite: HashTable against std::unordered_map and AVLTree against
+// std::set over int, short string and long string keys, several sizes and
+// uniform or Zipfian access.
+//
+//   HashTable / unordered_map: insert, find_hit, find_miss, remove, iterate
+//   AVLTree / set:             insert, find, successor, range, iterate
+//
+// Every row is one workload; ns_per_op is the wall time divided by the
+// operations it ran (keys inserted, lookups, keys visited by an iteration).
+// AVLTree keeps keys only, so its baseline is std::set rather than std::map.
+//
+// Options (defaults in brackets):
+//   --sizes=1000,100000,1000000   keys in the structure, up to 100000000
+//   --keys=int,short,long         key types
+//   --dists=uniform,zipf          how queries pick keys (zipf: s = 0.99)
+//   --ops=1000000                 queries per lookup workload
+//   --format=csv                  csv or json
+//
+// Prints CSV: structure,key_type,size,distribution,workload,ops,ns_per_op
+// or the same fields as a JSON array of objects.
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../HashTable.h"
+#include "../AVL.h"
+
+using Clock = std::chrono::steady_clock;
+
+// results are folded in here so the compiler cannot drop the work
+static unsigned long long sink = 0;
+
+static unsigned long long fold(int key) { return static_cast<unsigned>(key); }
+static unsigned long long fold(const std::string& key) { return key.size() + key.back(); }
+
+template<typename Fun>
+double time_ns(Fun fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+class Reporter {
+    bool json;
+    bool first;
+public:
+    explicit Reporter(bool json) : json(json), first(true) {
+        if (json) std::cout << "[\n";
+        else std::cout << "structure,key_type,size,distribution,workload,ops,ns_per_op\n";
+    }
+
+    ~Reporter() {
+        if (json) std::cout << "\n]\n";
+    }
+
+    void row(const char* structure, const char* key_type, long long size, const char* dist,
+             const char* workload, long long ops, double ns) {
+        double per_op = ops > 0 ? ns / ops : 0;
+        if (json) {
+            std::cout << (first ? "" : ",\n") << "  {\"structure\": \"" << structure << "\", \"key_type\": \""
+                      << key_type << "\", \"size\": " << size << ", \"distribution\": \"" << dist
+                      << "\", \"workload\": \"" << workload << "\", \"ops\": " << ops
+                      << ", \"ns_per_op\": " << per_op << "}";
+        } else {
+            std::cout << structure << "," << key_type << "," << size << "," << dist << "," << workload << ","
+                      << ops << "," << per_op << "\n";
+        }
+        std::cout.flush();
+        first = false;
+    }
+};
+
+// Zipfian ranks in [0, n) as in YCSB (Gray et al.), O(1) per draw after an
+// O(n) setup
+class Zipf {
+    double theta, zetan, alpha, eta;
+    uint64_t n;
+public:
+    explicit Zipf(uint64_t n, double theta = 0.99) : theta(theta), zetan(0), n(n) {
+        for (uint64_t i = 1; i <= n; ++i) zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+        double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+    }
+
+    uint64_t operator()(double u) const {
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta)) return 1;
+        uint64_t r = static_cast<uint64_t>(n * std::pow(eta * u - eta + 1.0, alpha));
+        return r < n ? r : n - 1;
+    }
+};
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// The i-th key of each type; distinct for distinct i < 2^32 because
+// multiplying by an odd constant is a bijection on 32 bits
+struct IntKeys {
+    typedef int type;
+    static const char* name() { return "int"; }
+    static int make(uint64_t i) { return static_cast<int>(static_cast<uint32_t>(i) * 2654435761u); }
+};
+
+static std::string hex(uint32_t v) {
+    char buf[9];
+    std::snprintf(buf, sizeof(buf), "%08x", v);
+    return buf;
+}
+
+// fits in std::string's inline buffer
+struct ShortKeys {
+    typedef std::string type;
+    static const char* name() { return "short_string"; }
+    static std::string make(uint64_t i) { return "k" + hex(static_cast<uint32_t>(i) * 2654435761u); }
+};
+
+// heap allocated, with a long shared prefix like paths or URLs
+struct LongKeys {
+    typedef std::string type;
+    static const char* name() { return "long_string"; }
+    static std::string make(uint64_t i) {
+        return "/tenants/acme-corporation/users/" + hex(static_cast<uint32_t>(i) * 2654435761u) + "/profile";
+    }
+};
+
+// Keys stored in the structures, keys never stored, and the positions the
+// queries of one distribution pick among them
+template<typename Keys>
+struct Dataset {
+    typedef typename Keys::type K;
+    std::vector<K> present;
+    std::vector<K> absent;
+    std::vector<uint32_t> picks;
+
+    Dataset(uint64_t n, uint64_t ops, bool zipf) {
+        present.reserve(n);
+        for (uint64_t i = 0; i < n; ++i) present.push_back(Keys::make(i));
+        absent.reserve(std::min(n, ops));
+        for (uint64_t i = 0; i < std::min(n, ops); ++i) absent.push_back(Keys::make(n + i));
+        picks.resize(ops);
+        std::mt19937_64 rng(n * 2 + zipf);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        if (zipf) {
+            // the hottest ranks land on scattered keys, not on the first ones inserted
+            Zipf z(n);
+            for (auto& p : picks) p = static_cast<uint32_t>(mix64(z(unit(rng))) % n);
+        } else {
+            for (auto& p : picks) p = static_cast<uint32_t>(rng() % n);
+        }
+    }
+};
+
+template<typename Keys>
+void hash_workloads(Reporter& out, const Dataset<Keys>& data, const char* dist) {
+    typedef typename Keys::type K;
+    long long n = static_cast<long long>(data.present.size());
+    long long ops = static_cast<long long>(data.picks.size());
+    const std::vector<K>& present = data.present;
+    const std::vector<K>& absent = data.absent;
+    const std::vector<uint32_t>& picks = data.picks;
+
+    {
+        HashTable<K, int> table;
+        out.row("HashTable", Keys::name(), n, dist, "insert", n, time_ns([&] {
+            for (long long i = 0; i < n; ++i) table.insert(present[i], static_cast<int>(i));
+        }));
+        out.row("HashTable", Keys::name(), n, dist, "find_hit", ops, time_ns([&] {
+            for (uint32_t p : picks) sink += table.find(present[p]);
+        }));
+        out.row("HashTable", Keys::name(), n, dist, "find_miss", ops, time_ns([&] {
+            for (uint32_t p : picks) sink += table.find(absent[p % absent.size()]);
+        }));
+        out.row("HashTable", Keys::name(), n, dist, "iterate", n, time_ns([&] {
+            for (auto it = table.begin(); it != table.end(); ++it) sink += (*it).second;
+        }));
+        // under zipf most picks repeat, so later removes mostly miss
+        out.row("HashTable", Keys::name(), n, dist, "remove", ops, time_ns([&] {
+            for (uint32_t p : picks) sink += table.remove(present[p]);
+        }));
+    }
+    {
+        std::unordered_map<K, int> table;
+        out.row("std::unordered_map", Keys::name(), n, dist, "insert", n, time_ns([&] {
+            for (long long i = 0; i < n; ++i) table.insert({present[i], static_cast<int>(i)});
+        }));
+        out.row("std::unordered_map", Keys::name(), n, dist, "find_hit", ops, time_ns([&] {
+            for (uint32_t p : picks) sink += table.count(present[p]);
+        }));
+        out.row("std::unordered_map", Keys::name(), n, dist, "find_miss", ops, time_ns([&] {
+            for (uint32_t p : picks) sink += table.count(absent[p % absent.size()]);
+        }));
+        out.row("std::unordered_map", Keys::name(), n, dist, "iterate", n, time_ns([&] {
+            for (auto& kv : table) sink += kv.second;
+        }));
+        out.row("std::unordered_map", Keys::name(), n, dist, "remove", ops, time_ns([&] {
+            for (uint32_t p : picks) sink += table.erase(present[p]);
+        }));
+    }
+}
+
+template<typename Keys>
+void tree_workloads(Reporter& out, const Dataset<Keys>& data, const char* dist) {
+    typedef typename Keys::type K;
+    long long n = static_cast<long long>(data.present.size());
+    long long ops = static_cast<long long>(data.picks.size());
+    const std::vector<K>& present = data.present;
+    const std::vector<uint32_t>& picks = data.picks;
+
+    // ranges span the next 100 keys in order; successor skips the largest key
+    std::vector<K> sorted(present);
+    std::sort(sorted.begin(), sorted.end());
+    const K& largest = sorted.back();
+    const int span = 100;
+
+    {
+        AVLTree<K> tree;
+        out.row("AVLTree", Keys::name(), n, dist, "insert", n, time_ns([&] {
+            for (long long i = 0; i < n; ++i) tree.insert(present[i]);
+        }));
+        out.row("AVLTree", Keys::name(), n, dist, "find", ops, time_ns([&] {
+            for (uint32_t p : picks) sink += tree.find(present[p]);
+        }));
+        out.row("AVLTree", Keys::name(), n, dist, "successor", ops, time_ns([&] {
+            for (uint32_t p : picks) {
+                if (present[p] < largest) sink += fold(tree.successor(present[p]));
+            }
+        }));
+        long long visited = 0;
+        double range_ns = time_ns([&] {
+            for (uint32_t p : picks) {
+                const K& hi = sorted[std::min<long long>(p + span, n - 1)];
+                tree.for_each_in_range(sorted[p], hi, [&](const K&) { ++visited; });
+            }
+        });
+        sink += visited;
+        out.row("AVLTree", Keys::name(), n, dist, "range", ops, range_ns);
+        out.row("AVLTree", Keys::name(), n, dist, "iterate", n, time_ns([&] {
+            for (auto it = tree.begin(); it != tree.end(); ++it) sink += fold(*it);
+        }));
+    }
+    {
+        std::set<K> tree;
+        out.row("std::set", Keys::name(), n, dist, "insert", n, time_ns([&] {
+            for (long long i = 0; i < n; ++i) tree.insert(present[i]);
+        }));
+        out.row("std::set", Keys::name(), n, dist, "find", ops, time_ns([&] {
+            for (uint32_t p : picks) sink += tree.count(present[p]);
+        }));
+        out.row("std::set", Keys::name(), n, dist, "successor", ops, time_ns([&] {
+            for (uint32_t p : picks) {
+                if (present[p] < largest) sink += fold(*tree.upper_bound(present[p]));
+            }
+        }));
+        long long visited = 0;
+        double range_ns = time_ns([&] {
+            for (uint32_t p : picks) {
+                const K& hi = sorted[std::min<long long>(p + span, n - 1)];
+                for (auto it = tree.lower_bound(sorted[p]); it != tree.end() && !(hi < *it); ++it) ++visited;
+            }
+        });
+        sink += visited;
+        out.row("std::set", Keys::name(), n, dist, "range", ops, range_ns);
+        out.row("std::set", Keys::name(), n, dist, "iterate", n, time_ns([&] {
+            for (const K& key : tree) sink += fold(key);
+        }));
+    }
+}
+
+template<typename Keys>
+void run(Reporter& out, uint64_t n, uint64_t ops, const std::vector<std::string>& dists) {
+    for (const std::string& dist : dists) {
+        Dataset<Keys> data(n, ops, dist == "zipf");
+        hash_workloads(out, data, dist.c_str());
+        tree_workloads(out, data, dist.c_str());
+    }
+}
+
+static std::vector<std::string> split(const std::string& s) {
+    std::vector<std::string> parts;
+    std::stringstream in(s);
+    std::string part;
+    while (std::getline(in, part, ',')) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+int main(int argc, char const *argv[]) {
+    std::vector<std::string> sizes = {"1000", "100000", "1000000"};
+    std::vector<std::string> keys = {"int", "short", "long"};
+    std::vector<std::string> dists = {"uniform", "zipf"};
+    uint64_t ops = 1000000;
+    std::string format = "csv";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq), value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (name == "--sizes") sizes = split(value);
+        else if (name == "--keys") keys = split(value);
+        else if (name == "--dists") dists = split(value);
+        else if (name == "--ops") ops = std::strtoull(value.c_str(), nullptr, 10);
+        else if (name == "--format") format = value;
+        else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 2;
+        }
+    }
+    if (format != "csv" && format != "json") {
+        std::cerr << "--format must be csv or json\n";
+        return 2;
+    }
+    for (const std::string& dist : dists) {
+        if (dist != "uniform" && dist != "zipf") {
+            std::cerr << "unknown distribution " << dist << "\n";
+            return 2;
+        }
+    }
+
+    Reporter out(format == "json");
+    for (const std::string& size : sizes) {
+        uint64_t n = std::strtoull(size.c_str(), nullptr, 10);
+        if (n < 2 || n > 100000000) {
+            std::cerr << "sizes must be in [2, 100000000]\n";
+            return 2;
+        }
+        for (const std::string& key : keys) {
+            if (key == "int") run<IntKeys>(out, n, ops, dists);
+            else if (key == "short") run<ShortKeys>(out, n, ops, dists);
+            else if (key == "long") run<LongKeys>(out, n, ops, dists);
+            else {
+                std::cerr << "unknown key type " << key << "\n";
+                return 2;
+            }
+        }
+    }
+    return sink == 42 ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+// Speedup of the parallel AVLTree bulk operations over 1/2/4/8/16 threads.
+// Prints CSV: operation,threads,keys,ms,speedup
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include "../AVL.h"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Fun>
+double time_ms(Fun fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char const *argv[]) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 4000000;
+    const int thread_counts[] = {1, 2, 4, 8, 16};
+
+    // a: even keys, b: multiples of three, so the set operations overlap
+    std::unique_ptr<int[]> a(new int[n]), b(new int[n]), shuffled(new int[n]);
+    for (int i = 0; i < n; ++i) {
+        a[i] = 2 * i;
+        b[i] = 3 * i;
+        shuffled[i] = 5 * i;
+    }
+    std::shuffle(shuffled.get(), shuffled.get() + n, std::mt19937(42));
+
+    const char* ops[] = {"from_sorted", "set_union", "set_intersection", "set_difference", "insert_many"};
+    double base[5] = {0, 0, 0, 0, 0};
+
+    std::cout << "operation,threads,keys,ms,speedup\n";
+    for (int threads : thread_counts) {
+        WorkStealingPool pool(threads);
+        double ms[5];
+
+        ms[0] = time_ms([&] {
+            auto t = AVLTree<int>::from_sorted(a.get(), a.get() + n, pool);
+        });
+
+        auto other = AVLTree<int>::from_sorted(b.get(), b.get() + n, pool);
+        {
+            auto t = AVLTree<int>::from_sorted(a.get(), a.get() + n, pool);
+            ms[1] = time_ms([&] { t.set_union(other, pool); });
+        }
+        {
+            auto t = AVLTree<int>::from_sorted(a.get(), a.get() + n, pool);
+            ms[2] = time_ms([&] { t.set_intersection(other, pool); });
+        }
+        {
+            auto t = AVLTree<int>::from_sorted(a.get(), a.get() + n, pool);
+            ms[3] = time_ms([&] { t.set_difference(other, pool); });
+        }
+        {
+            auto t = AVLTree<int>::from_sorted(a.get(), a.get() + n, pool);
+            ms[4] = time_ms([&] { t.insert_many(shuffled.get(), shuffled.get() + n, pool); });
+        }
+
+        for (int op = 0; op < 5; ++op) {
+            if (threads == 1) base[op] = ms[op];
+            std::cout << ops[op] << "," << threads << "," << n << "," << ms[op] << ","
+                      << base[op] / ms[op] << "\n";
+        }
+    }
+    return 0;
+}
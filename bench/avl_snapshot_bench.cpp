@@ -0,0 +1,76 @@
+// Checkpointing an AVLTree<int>: getInOrder() written as text and read back
+// with one insert per key, against save()/load() of a sorted run.
+// Prints CSV: method,keys,save_ms,load_ms,bytes
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../AVL.h"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Fun>
+double time_ms(Fun fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char const *argv[]) {
+    int keys = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    std::string path = argc > 2 ? argv[2] : "avl_snapshot_bench.bin";
+
+    AVLTree<int> tree;
+    std::mt19937 rng(42);
+    for (int i = 0; i < keys; ++i) tree.insert(static_cast<int>(rng() % (8u * keys)));
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "cannot open " << path << "\n";
+        return 1;
+    }
+
+    double text_save = time_ms([&] {
+        std::string text = tree.getInOrder();
+        if (write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size())) std::abort();
+    });
+    off_t text_bytes = lseek(fd, 0, SEEK_END);
+    AVLTree<int> from_text;
+    double text_load = time_ms([&] {
+        std::string text(static_cast<size_t>(text_bytes), '\0');
+        if (pread(fd, &text[0], text.size(), 0) != static_cast<ssize_t>(text.size())) std::abort();
+        const char* p = text.c_str();
+        char* end;
+        for (long v = std::strtol(p, &end, 10); end != p; v = std::strtol(p, &end, 10)) {
+            from_text.insert(static_cast<int>(v));
+            p = end;
+        }
+    });
+
+    if (ftruncate(fd, 0) != 0) std::abort();
+    lseek(fd, 0, SEEK_SET);
+    double run_save = time_ms([&] {
+        tree.save(fd);
+    });
+    off_t run_bytes = lseek(fd, 0, SEEK_END);
+    lseek(fd, 0, SEEK_SET);
+    AVLTree<int> from_run;
+    double run_load = time_ms([&] {
+        from_run = AVLTree<int>::load(fd);
+    });
+    close(fd);
+    std::remove(path.c_str());
+
+    if (from_text.size() != tree.size() || from_run.size() != tree.size()) {
+        std::cerr << "reloaded tree has the wrong size\n";
+        return 1;
+    }
+    std::cout << "method,keys,save_ms,load_ms,bytes\n";
+    std::cout << "in_order_text," << tree.size() << "," << text_save << "," << text_load << "," << text_bytes << "\n";
+    std::cout << "sorted_run," << tree.size() << "," << run_save << "," << run_load << "," << run_bytes << "\n";
+    return 0;
+}
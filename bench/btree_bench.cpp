@@ -0,0 +1,64 @@
+// BTree against AVLTree on random int keys.
+// Prints CSV: structure,keys,insert_ms,find_hit_ms,find_miss_ms,bytes_per_key
+// Configure with -DAED_NATIVE=ON to let the node search use AVX2.
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "../AVL.h"
+#include "../BTree.h"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Fun>
+double time_ms(Fun fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template<typename Tree, typename Bytes>
+void run(const char* name, Tree& tree, const std::vector<int>& keys, const std::vector<int>& misses, Bytes bytes_of) {
+    long long found = 0;
+    double insert_ms = time_ms([&] {
+        for (int k : keys) tree.insert(k);
+    });
+    double hit_ms = time_ms([&] {
+        for (int k : keys) found += tree.find(k);
+    });
+    double miss_ms = time_ms([&] {
+        for (int k : misses) found += tree.find(k);
+    });
+    if (found != static_cast<long long>(keys.size())) std::cerr << name << ": wrong lookups\n";
+    double bytes = bytes_of(tree);
+    std::cout << name << "," << keys.size() << "," << insert_ms << "," << hit_ms << "," << miss_ms << ","
+              << bytes / keys.size() << "\n";
+}
+
+int main(int argc, char const *argv[]) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 5000000;
+
+    // even keys are inserted, odd keys are misses
+    std::vector<int> keys(n), misses(n);
+    for (int i = 0; i < n; ++i) {
+        keys[i] = 2 * i;
+        misses[i] = 2 * i + 1;
+    }
+    std::mt19937 rng(42);
+    std::shuffle(keys.begin(), keys.end(), rng);
+    std::shuffle(misses.begin(), misses.end(), rng);
+
+    std::cout << "structure,keys,insert_ms,find_hit_ms,find_miss_ms,bytes_per_key\n";
+    {
+        AVLTree<int> avl;
+        // the arena adds one pointer per 256 nodes
+        run("avl", avl, keys, misses, [](AVLTree<int>& t) { return double(t.size()) * sizeof(NodeAVL<int>); });
+    }
+    {
+        BTree<int> btree;
+        run("btree", btree, keys, misses, [](BTree<int>& t) { return double(t.memoryUsage()); });
+    }
+    return 0;
+}
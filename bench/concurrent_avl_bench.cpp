@@ -0,0 +1,155 @@
+// ConcurrentAVLTree against an AVLTree behind a shared_mutex with 1/2/4/8/16
+// reader threads and one writer, in two workloads:
+//   lookup  readers time their finds while the writer updates throughout
+//   update  the writer times its inserts and removes while readers keep
+//           calling find; a writer of the locked tree waits for the readers
+//           to let go of the lock, the optimistic tree never makes it wait
+// Prints CSV: tree,workload,readers,ops,ms,mops_per_s
+//
+// The correctness stress test lives in tests/concurrent_avl_test.cpp.
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include "../ConcurrentAVL.h"
+#include "../AVL.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Same interface as ConcurrentAVLTree for the timing loop
+struct LockedAVLTree {
+    AVLTree<int> tree;
+    mutable std::shared_mutex lock;
+
+    void insert(int k) {
+        std::unique_lock<std::shared_mutex> g(lock);
+        tree.insert(k);
+    }
+
+    void remove(int k) {
+        std::unique_lock<std::shared_mutex> g(lock);
+        tree.remove(k);
+    }
+
+    bool find(int k) {
+        std::shared_lock<std::shared_mutex> g(lock);
+        return tree.find(k);
+    }
+};
+
+template<typename Tree>
+double read_ms(Tree& tree, int keys, int readers, int lookups) {
+    std::atomic<bool> go(false), stop(false);
+    std::atomic<long long> found(0);
+
+    std::thread writer([&] {
+        std::mt19937 rng(7);
+        while (!stop.load()) {
+            int k = static_cast<int>(rng() % keys) * 2;
+            tree.remove(k);
+            tree.insert(k);
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::mt19937 rng(r + 100);
+            long long hits = 0;
+            while (!go.load()) std::this_thread::yield();
+            for (int i = 0; i < lookups; ++i) {
+                hits += tree.find(static_cast<int>(rng() % (2 * keys)));
+            }
+            found.fetch_add(hits);
+        });
+    }
+
+    auto start = Clock::now();
+    go.store(true);
+    for (auto& t : threads) t.join();
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    stop.store(true);
+    writer.join();
+    return ms;
+}
+
+// Inserts and removes odd keys, none of which the tree holds, for `budget`
+// milliseconds while the readers keep calling find; returns the operations
+// the writer finished in that time
+template<typename Tree>
+long long update_ops(Tree& tree, int keys, int readers, double budget) {
+    std::atomic<bool> stop(false);
+    std::atomic<int> ready(0);
+    std::atomic<long long> found(0), ops(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::mt19937 rng(r + 100);
+            long long hits = 0;
+            ready.fetch_add(1);
+            while (!stop.load(std::memory_order_relaxed)) {
+                hits += tree.find(static_cast<int>(rng() % (2 * keys)));
+            }
+            found.fetch_add(hits);
+        });
+    }
+    while (ready.load() < readers) std::this_thread::yield();
+
+    // a starved writer would never look at a clock, so the main thread keeps time
+    std::thread writer([&] {
+        std::mt19937 rng(7);
+        while (!stop.load(std::memory_order_relaxed)) {
+            int k = static_cast<int>(rng() % keys) * 2 + 1;
+            tree.insert(k);
+            tree.remove(k);
+            ops.fetch_add(2, std::memory_order_relaxed);
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(budget));
+    long long done = ops.load();
+    stop.store(true);
+    writer.join();
+    for (auto& t : threads) t.join();
+    return done;
+}
+
+int main(int argc, char const *argv[]) {
+    int keys = argc > 1 ? std::atoi(argv[1]) : 1 << 20;
+    int lookups = argc > 2 ? std::atoi(argv[2]) : 2000000;
+    double budget = argc > 3 ? std::atof(argv[3]) : 500;
+    const int reader_counts[] = {1, 2, 4, 8, 16};
+
+    ConcurrentAVLTree<int> optimistic;
+    LockedAVLTree locked;
+    // even keys only, so the update workload never collides with a stored key
+    for (int i = 0; i < keys; ++i) {
+        optimistic.insert(2 * i);
+        locked.insert(2 * i);
+    }
+
+    std::cout << "tree,workload,readers,ops,ms,mops_per_s\n";
+    for (int readers : reader_counts) {
+        double ms = read_ms(optimistic, keys, readers, lookups);
+        std::cout << "optimistic,lookup," << readers << "," << 1LL * readers * lookups << "," << ms << ","
+                  << readers * (lookups / 1000.0) / ms << "\n";
+        ms = read_ms(locked, keys, readers, lookups);
+        std::cout << "locked,lookup," << readers << "," << 1LL * readers * lookups << "," << ms << ","
+                  << readers * (lookups / 1000.0) / ms << "\n";
+    }
+    for (int readers : reader_counts) {
+        long long ops = update_ops(optimistic, keys, readers, budget);
+        std::cout << "optimistic,update," << readers << "," << ops << "," << budget << ","
+                  << ops / 1000.0 / budget << "\n";
+        ops = update_ops(locked, keys, readers, budget);
+        std::cout << "locked,update," << readers << "," << ops << "," << budget << ","
+                  << ops / 1000.0 / budget << "\n";
+    }
+    return 0;
+}
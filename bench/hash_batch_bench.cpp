@@ -0,0 +1,73 @@
+// Batched HashTable operations against one call per key, in batches of 256
+// random keys on a table larger than the cache; insert_all passes every key
+// to a single insert_many, which sizes the table once.
+// Prints CSV: operation,keys,single_ms,batched_ms
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "../HashTable.h"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Fun>
+double time_ms(Fun fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char const *argv[]) {
+    int keys = argc > 1 ? std::atoi(argv[1]) : 1 << 22;
+    int lookups = argc > 2 ? std::atoi(argv[2]) : 8000000;
+    const int batch = 256;
+
+    std::mt19937 rng(42);
+    std::vector<pair<int, int>> items(keys);
+    for (int i = 0; i < keys; ++i) items[i] = {static_cast<int>(rng()), i};
+    // half of the queries miss
+    std::vector<int> queries(lookups);
+    for (int& key : queries) key = rng() % 2 ? items[rng() % keys].first : static_cast<int>(rng());
+
+    HashTable<int, int> single;
+    double single_insert = time_ms([&] {
+        for (const auto& item : items) single.insert(item);
+    });
+    HashTable<int, int> batched;
+    double batched_insert = time_ms([&] {
+        for (int base = 0; base < keys; base += batch) {
+            batched.insert_many(items.data() + base, std::min(batch, keys - base));
+        }
+    });
+
+    HashTable<int, int> all;
+    double all_insert = time_ms([&] {
+        all.insert_many(items.data(), keys);
+    });
+
+    long long single_found = 0, batched_found = 0;
+    double single_find = time_ms([&] {
+        for (int key : queries) single_found += single.find(key);
+    });
+    std::unique_ptr<bool[]> found(new bool[batch]);
+    double batched_find = time_ms([&] {
+        for (int base = 0; base < lookups; base += batch) {
+            int n = std::min(batch, lookups - base);
+            batched.find_many(queries.data() + base, n, found.get());
+            for (int i = 0; i < n; ++i) batched_found += found[i];
+        }
+    });
+    if (single_found != batched_found || single.getSize() != batched.getSize() ||
+        single.getSize() != all.getSize()) {
+        std::cerr << "batched operations disagree with single ones\n";
+        return 1;
+    }
+
+    std::cout << "operation,keys,single_ms,batched_ms\n";
+    std::cout << "insert," << keys << "," << single_insert << "," << batched_insert << "\n";
+    std::cout << "insert_all," << keys << "," << single_insert << "," << all_insert << "\n";
+    std::cout << "find," << lookups << "," << single_find << "," << batched_find << "\n";
+    return 0;
+}
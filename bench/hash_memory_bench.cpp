@@ -0,0 +1,63 @@
+// Memory held by a HashTable<string, float> per entry, against
+// std::unordered_map with the same allocator. Both go through an allocator
+// that counts the bytes they ask for. Keys are short enough to stay inside
+// std::string; a longer key adds the same heap buffer to both. The capacity
+// doubles, so each size is the average over tables of n to 2n entries.
+// Prints CSV: structure,keys,bytes_per_entry
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include "../HashTable.h"
+
+static size_t live_bytes = 0;
+
+template <typename T>
+struct CountingAllocator {
+    typedef T value_type;
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+    T* allocate(size_t n) {
+        live_bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        live_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+    template <typename U>
+    bool operator==(const CountingAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>&) const { return false; }
+};
+
+typedef HashTable<std::string, float, DefaultHash<std::string>, DefaultKeyEqual<std::string>,
+                  CountingAllocator<pair<const std::string, float>>> Table;
+typedef std::unordered_map<std::string, float, std::hash<std::string>, std::equal_to<std::string>,
+                           CountingAllocator<std::pair<const std::string, float>>> Map;
+
+template <typename Container>
+static double bytes_per_entry(int n) {
+    double sum = 0;
+    int samples = 0;
+    for (int m = n; m < 2 * n; m += n / 4, ++samples) {
+        size_t before = live_bytes;
+        Container* c = new Container();
+        for (int i = 0; i < m; ++i) c->insert({"k" + std::to_string(i), static_cast<float>(i)});
+        sum += static_cast<double>(live_bytes - before + sizeof(Container)) / m;
+        delete c;
+    }
+    return sum / samples;
+}
+
+int main(int argc, char const *argv[]) {
+    int max_keys = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    std::cout << "structure,keys,bytes_per_entry\n";
+    for (int n = 1000; n <= max_keys; n *= 10) {
+        std::cout << "HashTable," << n << "," << bytes_per_entry<Table>(n) << "\n";
+        std::cout << "unordered_map," << n << "," << bytes_per_entry<Map>(n) << "\n";
+    }
+    return 0;
+}
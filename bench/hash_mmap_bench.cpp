@@ -0,0 +1,64 @@
+// Startup cost of a HashTable<string, float>: rebuilding it with one insert
+// per entry against opening a file written by MappedHashTable::save, and the
+// lookups each one serves afterwards.
+// Prints CSV: source,keys,load_ms,find_ms
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../MappedHashTable.h"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Fun>
+double time_ms(Fun fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char const *argv[]) {
+    int keys = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    std::string path = argc > 2 ? argv[2] : "hash_mmap_bench.bin";
+
+    std::vector<std::string> names(keys);
+    for (int i = 0; i < keys; ++i) names[i] = "user:" + std::to_string(i * 2654435761u);
+    std::mt19937 rng(42);
+    std::vector<std::string> queries(keys);
+    for (auto& q : queries) q = rng() % 2 ? names[rng() % keys] : "missing:" + std::to_string(rng());
+
+    HashTable<std::string, float> table;
+    double rebuild_ms = time_ms([&] {
+        for (int i = 0; i < keys; ++i) table.insert(names[i], i * 0.5f);
+    });
+    MappedHashTable<std::string, float>::save(table, path);
+
+    long long table_found = 0, mapped_found = 0;
+    double table_find = time_ms([&] {
+        for (const auto& q : queries) table_found += table.find(q);
+    });
+
+    double open_ms, mapped_find;
+    {
+        MappedHashTable<std::string, float>* mapped = nullptr;
+        open_ms = time_ms([&] {
+            mapped = new MappedHashTable<std::string, float>(path);
+        });
+        mapped_find = time_ms([&] {
+            for (const auto& q : queries) mapped_found += mapped->find(q);
+        });
+        delete mapped;
+    }
+    std::remove(path.c_str());
+    if (table_found != mapped_found) {
+        std::cerr << "mapped table disagrees with the original\n";
+        return 1;
+    }
+
+    std::cout << "source,keys,load_ms,find_ms\n";
+    std::cout << "rebuild," << keys << "," << rebuild_ms << "," << table_find << "\n";
+    std::cout << "mapped," << keys << "," << open_ms << "," << mapped_find << "\n";
+    return 0;
+}
@@ -0,0 +1,62 @@
+// HashTable lookups that hit and that miss at load factors 0.5 to 0.9, with the
+// table filled to the load factor without growing.
+// Prints CSV: kernel,capacity,load_factor,hit_ns,miss_ns
+//
+// The kernel is the control group the lookups compare at once (avx2, sse2 or
+// scalar, chosen for this CPU); hash_probe_bench_scalar is the same program
+// built with AED_SCALAR_PROBE for comparison.
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "../HashTable.h"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Fun>
+double ns_per(int lookups, Fun fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+}
+
+int main(int argc, char const *argv[]) {
+    int capacity = argc > 1 ? std::atoi(argv[1]) : 1 << 20;
+    int lookups = argc > 2 ? std::atoi(argv[2]) : 4000000;
+    const double loads[] = {0.5, 0.6, 0.7, 0.8, 0.9};
+
+    std::cout << "kernel,capacity,load_factor,hit_ns,miss_ns\n";
+    for (double load : loads) {
+        HashTable<int, int> table(capacity);
+        table.setMaxLoadFactor(0.95);
+        int n = static_cast<int>(load * table.getCapacity());
+
+        // stored keys are even, misses odd
+        std::mt19937 rng(42);
+        std::vector<int> hits(n);
+        for (int i = 0; i < n; ++i) {
+            hits[i] = 2 * i;
+            table.insert(2 * i, i);
+        }
+        std::shuffle(hits.begin(), hits.end(), rng);
+        std::vector<int> misses(lookups);
+        for (int& key : misses) key = 2 * static_cast<int>(rng() % (4 * n)) + 1;
+
+        long long found = 0;
+        double hit_ns = ns_per(lookups, [&] {
+            for (int i = 0; i < lookups; ++i) found += table.find(hits[i % n]);
+        });
+        double miss_ns = ns_per(lookups, [&] {
+            for (int key : misses) found += table.find(key);
+        });
+        if (found != lookups) {
+            std::cerr << "lookups returned wrong results\n";
+            return 1;
+        }
+        std::cout << ctrlGroupName() << "," << table.getCapacity() << "," << load << ","
+                  << hit_ns << "," << miss_ns << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Read scaling of LockFreeHashTable against the sharded ConcurrentHashTable
+// with 1/2/4/8/16 reader threads and one writer updating keys throughout.
+// Prints CSV: table,readers,lookups,ms,mlookups_per_s
+//
+// The correctness stress test lives in tests/lockfree_hash_test.cpp.
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include "../LockFreeHashTable.h"
+#include "../ConcurrentHashTable.h"
+
+using Clock = std::chrono::steady_clock;
+
+// values carry their key in the high bits, so a reader can tell a torn or
+// misplaced entry from a legitimate update
+static unsigned long long stamp(int key, unsigned long long version) {
+    return (static_cast<unsigned long long>(key) << 24) | (version & 0xFFFFFF);
+}
+
+template<typename Table>
+double read_ms(Table& table, int keys, int readers, int lookups) {
+    std::atomic<bool> go(false), stop(false);
+    std::atomic<long long> found(0);
+
+    std::thread writer([&] {
+        std::mt19937 rng(7);
+        unsigned long long version = 0;
+        while (!stop.load()) {
+            int key = static_cast<int>(rng() % keys);
+            table.insert(key, stamp(key, ++version));
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::mt19937 rng(r + 100);
+            long long hits = 0;
+            while (!go.load()) std::this_thread::yield();
+            for (int i = 0; i < lookups; ++i) {
+                hits += table.find(static_cast<int>(rng() % (2 * keys)));
+            }
+            found.fetch_add(hits);
+        });
+    }
+
+    auto start = Clock::now();
+    go.store(true);
+    for (auto& t : threads) t.join();
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    stop.store(true);
+    writer.join();
+    return ms;
+}
+
+int main(int argc, char const *argv[]) {
+    int keys = argc > 1 ? std::atoi(argv[1]) : 1 << 20;
+    int lookups = argc > 2 ? std::atoi(argv[2]) : 2000000;
+    const int reader_counts[] = {1, 2, 4, 8, 16};
+
+    LockFreeHashTable<int, unsigned long long> lock_free(keys);
+    ConcurrentHashTable<int, unsigned long long> sharded(16, keys / 16);
+    for (int i = 0; i < keys; ++i) {
+        lock_free.insert(i, stamp(i, 0));
+        sharded.insert(i, stamp(i, 0));
+    }
+
+    std::cout << "table,readers,lookups,ms,mlookups_per_s\n";
+    for (int readers : reader_counts) {
+        double ms = read_ms(lock_free, keys, readers, lookups);
+        std::cout << "lock_free," << readers << "," << 1LL * readers * lookups << "," << ms << ","
+                  << readers * (lookups / 1000.0) / ms << "\n";
+        ms = read_ms(sharded, keys, readers, lookups);
+        std::cout << "sharded," << readers << "," << 1LL * readers * lookups << "," << ms << ","
+                  << readers * (lookups / 1000.0) / ms << "\n";
+    }
+    return 0;
+}
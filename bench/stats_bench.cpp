@@ -0,0 +1,75 @@
+// Cost of the CollectStats policy: the same random inserts, finds and removes
+// on HashTable and AVLTree built with NoStats and with CollectStats.
+// Prints CSV: structure,stats,insert_ms,find_ms,remove_ms
+// and the collected statistics on stderr.
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <vector>
+#include "../HashTable.h"
+#include "../AVL.h"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Fun>
+double time_ms(Fun fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template<typename Stats>
+using Table = HashTable<int, int, DefaultHash<int>, DefaultKeyEqual<int>, std::allocator<pair<const int, int>>,
+                        PowerOfTwoPolicy, Stats>;
+
+template<typename Stats>
+using Tree = AVLTree<int, NodeAVL<int>, NodeArena<NodeAVL<int>>, Stats>;
+
+template<typename Dict>
+long long run(Dict& dict, const std::vector<int>& keys, const char* structure, const char* stats) {
+    long long found = 0;
+    double insert_ms = time_ms([&] {
+        for (int key : keys) dict.insert(key);
+    });
+    double find_ms = time_ms([&] {
+        for (int key : keys) found += dict.find(key);
+    });
+    double remove_ms = time_ms([&] {
+        for (size_t i = 0; i < keys.size(); i += 2) dict.remove(keys[i]);
+    });
+    std::cout << structure << "," << stats << "," << insert_ms << "," << find_ms << "," << remove_ms << "\n";
+    return found;
+}
+
+// HashTable::insert takes a key and a value
+template<typename Stats>
+struct TableSet : Table<Stats> {
+    void insert(int key) { Table<Stats>::insert(key, key); }
+};
+
+int main(int argc, char const *argv[]) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    std::mt19937 rng(42);
+    std::vector<int> keys(n);
+    for (int& key : keys) key = static_cast<int>(rng());
+
+    std::cout << "structure,stats,insert_ms,find_ms,remove_ms\n";
+    TableSet<NoStats> plain_table;
+    TableSet<CollectStats> table;
+    Tree<NoStats> plain_tree;
+    Tree<CollectStats> tree;
+    long long plain = run(plain_table, keys, "HashTable", "none") + run(plain_tree, keys, "AVLTree", "none");
+    long long collected = run(table, keys, "HashTable", "collect") + run(tree, keys, "AVLTree", "collect");
+    if (plain != collected) {
+        std::cerr << "instrumented structures disagree\n";
+        return 1;
+    }
+
+    std::cerr << "HashTable\n";
+    table.getStats().print(std::cerr);
+    std::cerr << "AVLTree\n";
+    tree.getStats().print(std::cerr);
+    return 0;
+}
@@ -0,0 +1,575 @@
+// AVLTree against a sorted vector: insert and remove, the lazy iterators in
+// every order and direction, rank, select, count_range and percentile,
+// bounds and range scans, the parallel build and set operations, and split
+// and join with the default NodeArena, where split hands the upper nodes
+// over without copying them and both trees keep working after either one
+// is cleared.
+#undef NDEBUG
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// successor and predecessor name the key in their error message; declared
+// before AVL.h so its templates find it for string keys
+static std::string to_string(const std::string& s) {
+    return s;
+}
+
+#include "../AVL.h"
+#include "../tester.h"
+
+template <typename T>
+struct Keys {
+    static T make(int k) { return static_cast<T>(k); }
+};
+
+template <>
+struct Keys<std::string> {
+    // fixed width down to k = -999999, so the string order is the numeric order
+    static std::string make(int k) { return "key:" + std::to_string(2000000 + k); }
+};
+
+// random inserts and removes over [0, universe): inserting a key that is
+// already there and removing one that is not both happen all the time
+template <typename T>
+static void random_ops(AVLTree<T>& tree, std::vector<T>& expected, int universe, int ops, unsigned seed) {
+    std::mt19937 rng(seed);
+    for (int op = 0; op < ops; ++op) {
+        T key = Keys<T>::make(static_cast<int>(rng() % universe));
+        auto at = std::lower_bound(expected.begin(), expected.end(), key);
+        bool there = at != expected.end() && *at == key;
+        if (rng() % 3 != 0) {
+            tree.insert(key);
+            if (!there) expected.insert(at, key);
+        } else {
+            tree.remove(key);
+            if (there) expected.erase(at);
+        }
+    }
+}
+
+template <typename T>
+static std::vector<T> keys_of(AVLTree<T>& tree) {
+    std::vector<T> keys;
+    for (auto it = tree.begin(); it != tree.end(); ++it) keys.push_back(*it);
+    return keys;
+}
+
+template <typename T>
+static std::vector<const T*> addresses(AVLTree<T>& tree) {
+    std::vector<const T*> nodes;
+    for (auto it = tree.begin(); it != tree.end(); ++it) nodes.push_back(&*it);
+    return nodes;
+}
+
+template <typename T>
+static std::vector<T> keys_of(AVLTree<T>& tree, typename AVLTree<T>::iterator::Type type) {
+    std::vector<T> keys;
+    for (auto it = tree.begin(type); it != tree.end(); ++it) keys.push_back(*it);
+    return keys;
+}
+
+// the traversals the iterator does lazily, done recursively
+template <typename Node, typename T>
+static void preorder(const Node* n, std::vector<T>& out) {
+    if (!n) return;
+    out.push_back(n->data);
+    preorder(n->left, out);
+    preorder(n->right, out);
+}
+
+template <typename Node, typename T>
+static void postorder(const Node* n, std::vector<T>& out) {
+    if (!n) return;
+    postorder(n->left, out);
+    postorder(n->right, out);
+    out.push_back(n->data);
+}
+
+template <typename Node, typename T>
+static void bfs(const Node* root, std::vector<T>& out) {
+    std::queue<const Node*> level;
+    if (root) level.push(root);
+    while (!level.empty()) {
+        const Node* n = level.front();
+        level.pop();
+        out.push_back(n->data);
+        if (n->left) level.push(n->left);
+        if (n->right) level.push(n->right);
+    }
+}
+
+// every traversal order, reverse in-order, decrementing from either end and
+// a random walk back and forth, on a tree changed by inserts and removes
+template <typename T>
+static void iterators(int universe, const char* type) {
+    typedef typename AVLTree<T>::iterator It;
+    AVLTree<T> tree;
+    std::vector<T> expected;
+    random_ops(tree, expected, universe, 3 * universe, 7);
+    int n = static_cast<int>(expected.size());
+
+    std::vector<T> reversed(expected.rbegin(), expected.rend());
+    std::vector<T> backwards, upwards;
+    for (auto it = tree.rbegin(); it != tree.rend(); it++) backwards.push_back(*it);
+    It down = tree.end();
+    for (int i = 0; i < n; ++i) backwards.push_back(*--down);
+    It up = tree.rend();
+    for (int i = 0; i < n; ++i) upwards.push_back(*--up);
+    std::reverse(upwards.begin(), upwards.end());
+    std::vector<T> both = reversed;
+    both.insert(both.end(), reversed.begin(), reversed.end());
+    ASSERT(keys_of(tree) == expected && backwards == both && down == tree.begin() && upwards == reversed,
+           "In-order iteration of " << type << " keys does not match the sorted keys");
+    // the iterator traits let the standard algorithms take it
+    ASSERT(std::vector<T>(tree.begin(), tree.end()) == expected && std::distance(tree.begin(), tree.end()) == n
+           && std::vector<T>(tree.rbegin(), tree.rend()) == reversed,
+           "Standard algorithms over " << type << " keys do not see the sorted keys");
+
+    std::mt19937 rng(9);
+    It it = tree.begin();
+    int at = 0, wrong = 0;
+    for (int step = 0; step < 20000; ++step) {
+        if (rng() % 2 == 0 && at + 1 < n) {
+            ++it;
+            ++at;
+        } else if (at > 0) {
+            --it;
+            --at;
+        }
+        if (!(*it == expected[at]) || !(*it.operator->() == expected[at])) wrong++;
+    }
+    ASSERT(wrong == 0, "Stepping back and forth over " << type << " keys lost the position");
+
+    std::vector<T> pre, post, level;
+    preorder(tree.getRoot(), pre);
+    postorder(tree.getRoot(), post);
+    bfs(tree.getRoot(), level);
+    ASSERT(keys_of(tree, It::PreOrder) == pre && keys_of(tree, It::PostOrder) == post && keys_of(tree, It::BFS) == level,
+           "Pre-order, post-order or BFS iteration of " << type << " keys is wrong");
+    bool threw = false;
+    try {
+        It pre_it = tree.begin(It::PreOrder);
+        --pre_it;
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "A pre-order iterator of " << type << " keys stepped back");
+
+    AVLTree<T> empty;
+    It none = empty.end();
+    --none;
+    bool all_end = empty.begin() == empty.end() && empty.rbegin() == empty.rend() && none == empty.end();
+    for (auto order : {It::PreOrder, It::PostOrder, It::BFS}) all_end = all_end && empty.begin(order) == empty.end();
+    threw = false;
+    try {
+        *empty.begin();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(all_end && threw, "Iterators of an empty tree of " << type << " keys are not at the end");
+}
+
+// rank, select, count_range and percentile against positions in the
+// sorted keys, for keys in and around the tree
+template <typename T>
+static void order_statistics(int universe, const char* type) {
+    AVLTree<T> tree;
+    std::vector<T> expected;
+    random_ops(tree, expected, universe, 3 * universe, 13);
+    int n = static_cast<int>(expected.size());
+
+    int wrong = 0;
+    for (int i = 0; i < n; ++i) wrong += !(tree.select(i) == expected[i]);
+    for (int k = -2; k < universe + 2; ++k) {
+        T key = Keys<T>::make(k);
+        wrong += tree.rank(key) != std::lower_bound(expected.begin(), expected.end(), key) - expected.begin();
+    }
+    ASSERT(wrong == 0, "rank or select of " << type << " keys is wrong");
+
+    std::mt19937 rng(17);
+    for (int q = 0; q < 5000; ++q) {
+        int a = static_cast<int>(rng() % (universe + 4)) - 2, b = a + static_cast<int>(rng() % 60) - 10;
+        T lo = Keys<T>::make(a), hi = Keys<T>::make(b);
+        long want = hi < lo ? 0 : std::upper_bound(expected.begin(), expected.end(), hi)
+                                  - std::lower_bound(expected.begin(), expected.end(), lo);
+        wrong += tree.count_range(lo, hi) != want;
+    }
+    ASSERT(wrong == 0, "count_range of " << type << " keys is wrong");
+
+    for (int tenth = 0; tenth <= 1000; ++tenth) {
+        double p = tenth / 10.0;
+        int k = std::max(static_cast<int>(std::ceil(p / 100.0 * n)) - 1, 0);
+        wrong += !(tree.percentile(p) == expected[k]);
+    }
+    ASSERT(wrong == 0 && tree.percentile(0) == expected.front() && tree.percentile(100) == expected.back(),
+           "percentile of " << type << " keys is wrong");
+
+    int threw = 0;
+    for (int k : {-1, n}) {
+        try {
+            tree.select(k);
+        } catch (const std::out_of_range&) {
+            threw++;
+        }
+    }
+    for (double p : {-0.5, 100.5}) {
+        try {
+            tree.percentile(p);
+        } catch (const std::invalid_argument&) {
+            threw++;
+        }
+    }
+    ASSERT(threw == 4, "select or percentile of " << type << " keys accepted an index out of range");
+
+    AVLTree<T> empty;
+    threw = 0;
+    try {
+        empty.select(0);
+    } catch (const std::out_of_range&) {
+        threw++;
+    }
+    try {
+        empty.percentile(50);
+    } catch (const std::runtime_error&) {
+        threw++;
+    }
+    ASSERT(threw == 2 && empty.rank(Keys<T>::make(0)) == 0 && empty.count_range(Keys<T>::make(0), Keys<T>::make(9)) == 0,
+           "Order statistics of an empty tree of " << type << " keys are wrong");
+}
+
+// lower_bound, upper_bound and equal_range as positions in the sorted keys,
+// scans from a bound, for_each_in_range, for_each_in_ranges, successor and
+// predecessor, for keys in and around the tree
+template <typename T>
+static void bounds_and_ranges(int universe, const char* type) {
+    AVLTree<T> tree;
+    std::vector<T> expected;
+    random_ops(tree, expected, universe, 3 * universe, 19);
+    auto position = [&](typename AVLTree<T>::iterator it) -> long {
+        if (it == tree.end()) return static_cast<long>(expected.size());
+        auto at = std::lower_bound(expected.begin(), expected.end(), *it);
+        return at != expected.end() && *at == *it ? at - expected.begin() : -1;
+    };
+
+    int wrong = 0;
+    for (int k = -2; k < universe + 2; ++k) {
+        T key = Keys<T>::make(k);
+        long lo = std::lower_bound(expected.begin(), expected.end(), key) - expected.begin();
+        long hi = std::upper_bound(expected.begin(), expected.end(), key) - expected.begin();
+        auto range = tree.equal_range(key);
+        if (position(tree.lower_bound(key)) != lo || position(tree.upper_bound(key)) != hi
+            || position(range.first) != lo || position(range.second) != hi || tree.find(key) != (hi > lo)) wrong++;
+
+        if (hi == static_cast<long>(expected.size())) {
+            try {
+                tree.successor(key);
+                wrong++;
+            } catch (const std::invalid_argument&) {
+            }
+        } else if (!(tree.successor(key) == expected[hi])) {
+            wrong++;
+        }
+        if (lo == 0) {
+            try {
+                tree.predecessor(key);
+                wrong++;
+            } catch (const std::invalid_argument&) {
+            }
+        } else if (!(tree.predecessor(key) == expected[lo - 1])) {
+            wrong++;
+        }
+    }
+    ASSERT(wrong == 0, "Bounds, successor or predecessor of " << type << " keys are wrong");
+
+    std::mt19937 rng(23);
+    for (int q = 0; q < 2000; ++q) {
+        int a = static_cast<int>(rng() % (universe + 4)) - 2, b = a + static_cast<int>(rng() % 60) - 10;
+        T lo = Keys<T>::make(a), hi = Keys<T>::make(b);
+        auto first = std::lower_bound(expected.begin(), expected.end(), lo);
+        std::vector<T> want(first, hi < lo ? first : std::upper_bound(expected.begin(), expected.end(), hi));
+        std::vector<T> scanned, visited;
+        for (auto it = tree.lower_bound(lo); it != tree.end() && !(hi < *it); ++it) scanned.push_back(*it);
+        tree.for_each_in_range(lo, hi, [&](const T& key) { visited.push_back(key); });
+        if (scanned != want || visited != want) wrong++;
+        // stepping back from a bound reaches the keys below it
+        auto below = tree.lower_bound(lo);
+        if (first != expected.begin() && !(*--below == *std::prev(first))) wrong++;
+    }
+    ASSERT(wrong == 0, "Range scans of " << type << " keys are wrong");
+
+    std::vector<pair<T, T>> ranges;
+    for (int a = -2; a < universe; a += 50) ranges.emplace_back(Keys<T>::make(a), Keys<T>::make(a + 20));
+    std::vector<std::vector<T>> hits(ranges.size());
+    tree.for_each_in_ranges(ranges.data(), static_cast<int>(ranges.size()), [&](int i, const T& key) {
+        hits[i].push_back(key);
+    });
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        std::vector<T> want(std::lower_bound(expected.begin(), expected.end(), ranges[i].first),
+                            std::upper_bound(expected.begin(), expected.end(), ranges[i].second));
+        if (hits[i] != want) wrong++;
+    }
+    ASSERT(wrong == 0, "for_each_in_ranges of " << type << " keys is wrong");
+
+    AVLTree<T> empty;
+    T key = Keys<T>::make(0);
+    int visited = 0;
+    empty.for_each_in_range(key, Keys<T>::make(9), [&](const T&) { visited++; });
+    empty.for_each_in_ranges(ranges.data(), static_cast<int>(ranges.size()), [&](int, const T&) { visited++; });
+    int threw = 0;
+    try {
+        empty.successor(key);
+    } catch (const std::invalid_argument&) {
+        threw++;
+    }
+    try {
+        empty.predecessor(key);
+    } catch (const std::invalid_argument&) {
+        threw++;
+    }
+    ASSERT(visited == 0 && threw == 2 && empty.lower_bound(key) == empty.end() && empty.upper_bound(key) == empty.end()
+           && !empty.find(key), "Bounds and ranges of an empty tree of " << type << " keys are wrong");
+}
+
+// nodes whose height or size field is stale or whose subtrees differ in
+// height by more than one
+template <typename Node>
+static int shape_errors(const Node* n) {
+    if (!n) return 0;
+    int errors = shape_errors(n->left) + shape_errors(n->right);
+    int hl = n->left ? n->left->height : -1, hr = n->right ? n->right->height : -1;
+    int size = 1 + (n->left ? n->left->size : 0) + (n->right ? n->right->size : 0);
+    return errors + (n->height != 1 + std::max(hl, hr) || n->size != size || hl - hr > 1 || hr - hl > 1);
+}
+
+template <typename T>
+static bool matches(AVLTree<T>& tree, const std::vector<T>& expected) {
+    return tree.size() == static_cast<int>(expected.size()) && keys_of(tree) == expected
+           && shape_errors(tree.getRoot()) == 0;
+}
+
+template <typename T>
+static std::vector<T> shuffled(std::vector<T> keys, unsigned seed) {
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(seed));
+    return keys;
+}
+
+// from_sorted, set_union, set_intersection, set_difference, insert_many and
+// remove_many on a pool, against the serial versions and std::set_* on the
+// sorted keys, with grains small enough to fork all the way down
+template <typename T>
+static void parallel(int universe, const char* type) {
+    typedef AVLTree<T> Tree;
+    WorkStealingPool pool(4);
+    Tree a, b;
+    std::vector<T> ka, kb, both, common, only_a;
+    random_ops(a, ka, universe, 2 * universe, 29);
+    random_ops(b, kb, universe, universe, 31);
+    std::set_union(ka.begin(), ka.end(), kb.begin(), kb.end(), std::back_inserter(both));
+    std::set_intersection(ka.begin(), ka.end(), kb.begin(), kb.end(), std::back_inserter(common));
+    std::set_difference(ka.begin(), ka.end(), kb.begin(), kb.end(), std::back_inserter(only_a));
+    // b's keys twice and out of order
+    std::vector<T> bulk = shuffled(kb, 37);
+    bulk.insert(bulk.end(), kb.begin(), kb.end());
+
+    // a grain below 1 is taken as 1
+    for (int grain : {-3, 0, 1, 16, 256, Tree::ParallelGrain}) {
+        int wrong = 0;
+        Tree built = Tree::from_sorted(ka.begin(), ka.end(), pool, grain);
+        if (!matches(built, ka)) wrong++;
+
+        Tree u = Tree::from_sorted(ka.begin(), ka.end(), pool, grain);
+        Tree i = Tree::from_sorted(ka.begin(), ka.end(), pool, grain);
+        Tree d = Tree::from_sorted(ka.begin(), ka.end(), pool, grain);
+        u.set_union(b, pool, grain);
+        i.set_intersection(b, pool, grain);
+        d.set_difference(b, pool, grain);
+        if (!matches(u, both) || !matches(i, common) || !matches(d, only_a) || !matches(b, kb)) wrong++;
+
+        Tree many = Tree::from_sorted(ka.begin(), ka.end(), pool, grain);
+        many.insert_many(bulk.begin(), bulk.end(), pool, grain);
+        if (!matches(many, both)) wrong++;
+        many.remove_many(bulk.begin(), bulk.end(), pool, grain);
+        if (!matches(many, only_a)) wrong++;
+
+        // with itself and with an empty tree
+        Tree empty;
+        u.set_union(u, pool, grain);
+        i.set_intersection(i, pool, grain);
+        d.set_difference(d, pool, grain);
+        if (!matches(u, both) || !matches(i, common) || d.size() != 0) wrong++;
+        u.set_union(empty, pool, grain);
+        empty.set_union(i, pool, grain);
+        i.set_intersection(Tree(), pool, grain);
+        if (!matches(u, both) || !matches(empty, common) || i.size() != 0) wrong++;
+        Tree none = Tree::from_sorted(ka.end(), ka.end(), pool, grain);
+        none.insert_many(bulk.end(), bulk.end(), pool, grain);
+        if (none.size() != 0 || none.begin() != none.end()) wrong++;
+        ASSERT(wrong == 0, "Parallel operations on " << type << " keys with grain " << grain << " are wrong");
+    }
+
+    // the serial versions give the same trees
+    Tree u = Tree::from_sorted(ka.begin(), ka.end()), i = Tree::from_sorted(ka.begin(), ka.end());
+    Tree d = Tree::from_sorted(ka.begin(), ka.end()), many = Tree::from_sorted(ka.begin(), ka.end());
+    u.set_union(b);
+    i.set_intersection(b);
+    d.set_difference(b);
+    many.insert_many(bulk.begin(), bulk.end());
+    bool same = matches(u, both) && matches(i, common) && matches(d, only_a) && matches(many, both);
+    many.remove_many(bulk.begin(), bulk.end());
+    ASSERT(same && matches(many, only_a), "Serial set operations on " << type << " keys are wrong");
+
+    // keys out of order or repeated
+    int threw = 0;
+    std::vector<T> unsorted = ka, repeated = ka;
+    std::swap(unsorted[unsorted.size() / 3], unsorted[unsorted.size() / 3 + 1]);
+    repeated.insert(repeated.begin() + repeated.size() / 2, repeated[repeated.size() / 2]);
+    for (auto* keys : {&unsorted, &repeated}) {
+        try {
+            Tree::from_sorted(keys->begin(), keys->end());
+        } catch (const std::invalid_argument&) {
+            threw++;
+        }
+        for (int grain : {1, 16}) {
+            try {
+                Tree::from_sorted(keys->begin(), keys->end(), pool, grain);
+            } catch (const std::invalid_argument&) {
+                threw++;
+            }
+        }
+    }
+    ASSERT(threw == 6, "from_sorted of " << type << " keys accepted keys out of order");
+}
+
+// insert and remove one key at a time, with keys already there and keys
+// missing, in random, ascending and descending order: after each batch the
+// keys match and every node's height and size are exact
+template <typename T>
+static void insert_remove(int universe, const char* type) {
+    AVLTree<T> tree;
+    std::vector<T> expected;
+    int wrong = 0;
+    for (int batch = 0; batch < 40; ++batch) {
+        random_ops(tree, expected, universe, universe / 4, 41 + batch);
+        if (!matches(tree, expected)) wrong++;
+    }
+    ASSERT(wrong == 0, "Random inserts and removes of " << type << " keys are wrong");
+    int n = tree.size();
+    ASSERT(tree.height() <= 1.44 * std::log2(n + 2.0), "A tree of " << n << " " << type << " keys is "
+           << tree.height() << " levels high");
+
+    // removing everything, in random order and twice over
+    for (const T& key : shuffled(expected, 43)) {
+        tree.remove(key);
+        tree.remove(key);
+    }
+    ASSERT(tree.size() == 0 && tree.getRoot() == nullptr && tree.begin() == tree.end(),
+           "Removing every " << type << " key does not leave an empty tree");
+    tree.remove(Keys<T>::make(0));
+    ASSERT(tree.size() == 0, "Removing from an empty tree of " << type << " keys is not working");
+
+    // sorted runs rotate at every level
+    std::vector<T> ascending;
+    for (int k = 0; k < universe; ++k) ascending.push_back(Keys<T>::make(k));
+    for (const T& key : ascending) tree.insert(key);
+    for (const T& key : ascending) tree.insert(key);
+    bool up = matches(tree, ascending);
+    std::vector<T> kept;
+    for (int k = universe - 1; k >= 0; --k) {
+        if (k % 2 == 1) tree.remove(ascending[k]);
+    }
+    for (int k = 0; k < universe; k += 2) kept.push_back(ascending[k]);
+    bool half = matches(tree, kept);
+    tree.clear();
+    for (auto it = ascending.rbegin(); it != ascending.rend(); ++it) tree.insert(*it);
+    ASSERT(up && half && matches(tree, ascending), "Sorted inserts and removes of " << type << " keys are wrong");
+}
+
+// splits at random points and joins the parts back, over and over, on one
+// tree: both parts must match the oracle and keep their node addresses
+template <typename T>
+static void split_join(const std::vector<T>& universe, const char* type) {
+    std::mt19937 rng(11);
+    AVLTree<T> tree = AVLTree<T>::from_sorted(universe.begin(), universe.end());
+    std::vector<T> expected = universe;
+    int wrong = 0, copied = 0;
+    for (int round = 0; round < 200; ++round) {
+        const T& at = universe[rng() % universe.size()];
+        std::vector<const T*> before = addresses(tree);
+        AVLTree<T> greater;
+        bool had = tree.split(at, greater);
+
+        auto cut = std::lower_bound(expected.begin(), expected.end(), at);
+        bool expected_had = cut != expected.end() && *cut == at;
+        std::vector<T> low(expected.begin(), cut), high(cut + (expected_had ? 1 : 0), expected.end());
+        if (had != expected_had || keys_of(tree) != low || keys_of(greater) != high) wrong++;
+        // the upper nodes are the ones the tree had before the split
+        std::vector<const T*> after = addresses(greater);
+        size_t skip = low.size() + (expected_had ? 1 : 0);
+        if (!std::equal(after.begin(), after.end(), before.begin() + skip)) copied++;
+
+        // both parts keep allocating and freeing on their own
+        if (!high.empty()) {
+            greater.remove(high.back());
+            greater.insert(high.back());
+        }
+        tree.join(greater);
+        if (greater.size() != 0 || !tree.isBalanced()) wrong++;
+        // the split key comes back every other round, so later rounds also
+        // split at keys that are not there
+        if (round % 2 == 0) {
+            tree.insert(at);
+            if (!expected_had) expected.insert(cut, at);
+        } else if (expected_had) {
+            expected.erase(cut);
+        }
+    }
+    ASSERT(wrong == 0 && keys_of(tree) == expected, "split and join of " << type << " keys lose or misplace keys");
+    ASSERT(copied == 0, "split copied the upper part of " << type << " keys " << copied << " times");
+
+    // either part can be cleared or destroyed while the other lives on
+    {
+        AVLTree<T> greater;
+        tree.split(universe[universe.size() / 2], greater);
+        std::vector<T> high = keys_of(greater);
+        tree.clear();
+        for (const T& k : universe) tree.insert(k);
+        ASSERT(keys_of(greater) == high, "Clearing the lower part of a split damaged the upper part");
+        AVLTree<T> rest;
+        greater.split(high[high.size() / 2], rest);
+        std::vector<T> top = keys_of(rest);
+        greater.clear();
+        ASSERT(keys_of(rest) == top, "Clearing the middle part of a split damaged the upper part");
+    }
+    AVLTree<T> empty, other;
+    ASSERT(!empty.split(universe[0], other) && empty.size() == 0 && other.size() == 0,
+           "split of an empty tree is not working");
+}
+
+int main() {
+    insert_remove<int>(20000, "int");
+    insert_remove<std::string>(3000, "string");
+    iterators<int>(3000, "int");
+    iterators<std::string>(1000, "string");
+    order_statistics<int>(3000, "int");
+    order_statistics<std::string>(1000, "string");
+    bounds_and_ranges<int>(3000, "int");
+    bounds_and_ranges<std::string>(1000, "string");
+    parallel<int>(20000, "int");
+    parallel<std::string>(3000, "string");
+
+    std::vector<int> ints;
+    for (int k = 0; k < 20000; ++k) ints.push_back(3 * k);
+    split_join(ints, "int");
+    std::vector<std::string> strings;
+    for (int k = 0; k < 3000; ++k) strings.push_back("key:" + std::to_string(100000 + k));
+    split_join(strings, "string");
+
+    return TrueAsserts == TotalAsserts ? 0 : 1;
+}
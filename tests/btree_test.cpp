@@ -0,0 +1,147 @@
+// BTree against std::set: random inserts and removes with nodes small enough
+// to split and merge all the time, then iteration in both directions across
+// leaves, bounds, range scans, successor and predecessor. Integer keys take
+// the vector search, double and string keys the binary search.
+#undef NDEBUG
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// successor and predecessor name the key in their error message; declared
+// before BTree.h so its templates find it for string keys
+static std::string to_string(const std::string& s) {
+    return s;
+}
+
+#include "../BTree.h"
+#include "../tester.h"
+
+template <typename T>
+struct Keys {
+    static T make(int k) { return static_cast<T>(k); }
+};
+
+template <>
+struct Keys<std::string> {
+    // fixed width, so the string order is the numeric order; bound_errors
+    // also asks for keys a little below 0
+    static std::string make(int k) {
+        std::string s = std::to_string(k + 1000);
+        return "key:" + std::string(8 - s.size(), '0') + s;
+    }
+};
+
+template <typename Tree, typename T>
+static bool same_as(const Tree& tree, const std::set<T>& expected) {
+    if (tree.size() != static_cast<int>(expected.size())) return false;
+    if (!std::equal(tree.begin(), tree.end(), expected.begin(), expected.end())) return false;
+    return std::equal(tree.rbegin(), tree.rend(), expected.rbegin(), expected.rend());
+}
+
+// lower_bound, upper_bound, find, successor, predecessor and the range
+// [lower_bound(a), upper_bound(b)) for keys in and around the tree
+template <typename Tree, typename T>
+static int bound_errors(const Tree& tree, const std::set<T>& expected, int universe) {
+    int wrong = 0;
+    for (int k = -2; k < universe + 2; k += 3) {
+        T key = Keys<T>::make(k);
+        auto lo = tree.lower_bound(key);
+        auto want_lo = expected.lower_bound(key);
+        if ((lo == tree.end()) != (want_lo == expected.end()) || (lo != tree.end() && !(*lo == *want_lo))) wrong++;
+        auto hi = tree.upper_bound(key);
+        auto want_hi = expected.upper_bound(key);
+        if ((hi == tree.end()) != (want_hi == expected.end()) || (hi != tree.end() && !(*hi == *want_hi))) wrong++;
+        if (tree.find(key) != (expected.count(key) == 1)) wrong++;
+
+        if (want_hi == expected.end()) {
+            try {
+                tree.successor(key);
+                wrong++;
+            } catch (const std::invalid_argument&) {
+            }
+        } else if (!(tree.successor(key) == *want_hi)) {
+            wrong++;
+        }
+        if (want_lo == expected.begin()) {
+            try {
+                tree.predecessor(key);
+                wrong++;
+            } catch (const std::invalid_argument&) {
+            }
+        } else if (!(tree.predecessor(key) == *std::prev(want_lo))) {
+            wrong++;
+        }
+
+        T last = Keys<T>::make(k + 40);
+        std::vector<T> range(tree.lower_bound(key), tree.upper_bound(last));
+        std::vector<T> want_range(expected.lower_bound(key), expected.upper_bound(last));
+        if (range != want_range) wrong++;
+    }
+    return wrong;
+}
+
+template <typename T, int NodeKeys>
+static void against_set(int universe, int ops, const char* type) {
+    std::mt19937 rng(3);
+    BTree<T, NodeKeys> tree;
+    std::set<T> expected;
+    int wrong = 0, max_height = 1;
+    for (int op = 0; op < ops; ++op) {
+        T key = Keys<T>::make(static_cast<int>(rng() % universe));
+        // insert-heavy first half, remove-heavy second half, so the tree
+        // grows levels and then merges them away again
+        bool add = rng() % 4 < (op < ops / 2 ? 3u : 1u);
+        if (add) {
+            if (tree.insert(key) != expected.insert(key).second) wrong++;
+        } else {
+            if (tree.remove(key) != (expected.erase(key) == 1)) wrong++;
+        }
+        max_height = std::max(max_height, tree.height());
+        if (op % (ops / 10) == 0 && !same_as(tree, expected)) wrong++;
+    }
+    ASSERT(wrong == 0 && same_as(tree, expected), "BTree of " << type << " keys does not match the set");
+    ASSERT(bound_errors(tree, expected, universe) == 0, "Bounds, ranges or neighbours of " << type << " keys are wrong");
+    ASSERT(max_height >= 3, "BTree of " << type << " keys never grew past " << max_height << " levels");
+    if (!expected.empty()) {
+        ASSERT(tree.minValue() == *expected.begin() && tree.maxValue() == *expected.rbegin(),
+               "minValue or maxValue of " << type << " keys is wrong");
+    }
+
+    // removing everything merges back to a single leaf
+    for (const T& key : std::vector<T>(expected.begin(), expected.end())) wrong += !tree.remove(key);
+    ASSERT(wrong == 0 && tree.size() == 0 && tree.height() == 1 && tree.begin() == tree.end(),
+           "Removing every " << type << " key does not leave an empty leaf");
+}
+
+int main() {
+    // four keys per node: every few operations split or merge a node
+    against_set<int, 4>(3000, 60000, "int (4 per node)");
+    against_set<long long, 4>(3000, 60000, "long long (4 per node)");
+    against_set<double, 5>(3000, 60000, "double (5 per node)");
+    against_set<std::string, 4>(2000, 40000, "string (4 per node)");
+    against_set<int, BTreeNodeKeys<int>::value>(200000, 400000, "int");
+    against_set<long long, BTreeNodeKeys<long long>::value>(200000, 400000, "long long");
+
+    // the empty tree
+    BTree<int> empty;
+    ASSERT(empty.begin() == empty.end() && empty.rbegin() == empty.rend() && !empty.find(0)
+           && empty.lower_bound(0) == empty.end() && empty.upper_bound(0) == empty.end(),
+           "The empty tree is not empty");
+    bool threw = false;
+    try {
+        empty.minValue();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw && !empty.remove(1), "minValue or remove of an empty tree is not working");
+    empty.insert(1);
+    empty.clear();
+    ASSERT(empty.size() == 0 && empty.begin() == empty.end() && empty.memoryUsage() == BTree<int>().memoryUsage(),
+           "clear does not leave an empty tree");
+
+    return TrueAsserts == TotalAsserts ? 0 : 1;
+}
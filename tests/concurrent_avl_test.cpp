@@ -0,0 +1,80 @@
+// Stress test for ConcurrentAVLTree: every even key stays present while
+// writers toggle the odd ones, each its own share of them, and readers check
+// find, successor, predecessor, minValue and maxValue against that
+// invariant. The final contents are then compared with what the writers
+// did. Configure with
+// -DAED_TSAN=ON to run it under ThreadSanitizer, which fails the test on a
+// data race. Exits with 1 on a bad answer.
+#undef NDEBUG
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include "../ConcurrentAVL.h"
+#include "../tester.h"
+
+static void stress(int keys, int readers, int writers, int rounds) {
+    ConcurrentAVLTree<int> tree;
+    // one byte per key: writers set their own keys at the same time
+    std::vector<char> expected(keys, false);
+    for (int k = 0; k < keys; k += 2) {
+        tree.insert(k);
+        expected[k] = true;
+    }
+    std::atomic<bool> done(false);
+    std::atomic<int> bad(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::mt19937 rng(r + 1);
+            while (!done.load()) {
+                int k = static_cast<int>(rng() % (keys - 3)) + 1;
+                int even_above = k % 2 == 0 ? k + 2 : k + 1;
+                int even_below = k % 2 == 0 ? k - 2 : k - 1;
+                if (k % 2 == 0 && !tree.find(k)) bad.fetch_add(1);
+                int s = tree.successor(k);
+                if (s <= k || s > even_above) bad.fetch_add(1);
+                int p = tree.predecessor(k);
+                if (p >= k || p < even_below) bad.fetch_add(1);
+                if (tree.minValue() != 0 || tree.maxValue() < keys - 2) bad.fetch_add(1);
+            }
+        });
+    }
+
+    // writer w toggles the odd keys 2j + 1 with j % writers == w
+    std::vector<std::thread> writing;
+    for (int w = 0; w < writers; ++w) {
+        writing.emplace_back([&, w] {
+            std::mt19937 rng(100 + w);
+            int share = (keys / 2 - w + writers - 1) / writers;
+            for (int i = 0; i < rounds / writers; ++i) {
+                int k = (static_cast<int>(rng() % share) * writers + w) * 2 + 1;
+                if (!tree.remove(k)) tree.insert(k);
+                expected[k] = !expected[k];
+            }
+        });
+    }
+    for (auto& t : writing) t.join();
+    done.store(true);
+    for (auto& t : threads) t.join();
+    ASSERT(bad.load() == 0, "A reader saw an inconsistent answer");
+
+    int wrong = 0, present = 0;
+    for (int k = 0; k < keys; ++k) {
+        if (tree.find(k) != expected[k]) wrong++;
+        present += expected[k];
+    }
+    ASSERT(wrong == 0, "The tree does not hold what the writers left");
+    ASSERT(tree.size() == present, "The function size is not working");
+}
+
+int main() {
+    stress(1 << 12, 4, 1, 200000);
+    stress(1 << 12, 2, 4, 200000);
+    // a small tree rotates at the root all the time
+    stress(16, 4, 1, 100000);
+    stress(16, 2, 4, 100000);
+    return TrueAsserts == TotalAsserts ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// HashTable operations whose key or value is a reference into the table
+// itself, across the growth boundaries where entries move: the inline
+// buffer spilling to the heap, and every doubling after it, with and
+// without incremental rehash. The table takes keys and values by
+// reference, so each of these used to read an entry that the rehash or
+// the migration step had already moved or freed. Also the byte budget of
+// the inline buffer and the iterator traits.
+#undef NDEBUG
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "../HashTable.h"
+#include "../tester.h"
+
+typedef HashTable<std::string, std::string> Table;
+
+static std::string key(int i) {
+    return "k" + std::to_string(i);
+}
+
+static void self_references(bool incremental) {
+    const char* mode = incremental ? " with incremental rehash" : "";
+    const std::string big(100, 'x');
+
+    // insert and insert_or_assign of a value that lives in the table
+    {
+        Table t;
+        t.setIncrementalRehash(incremental);
+        t.insert("a", big);
+        int wrong = 0;
+        for (int i = 0; i < 2000; ++i) {
+            t.insert(key(i), t.at("a"));
+            if (t.at(key(i)) != big) wrong++;
+        }
+        for (int i = 0; i < 2000; ++i) {
+            t.insert_or_assign(key(i), t.at(key(1999 - i)));
+            if (t.at(key(i)) != big) wrong++;
+        }
+        ASSERT(wrong == 0, "insert(k, at(x)) copied a moved value" << mode);
+    }
+
+    // try_emplace and emplace with a value from the table. A reference
+    // from at() outlives only the calls that do not insert, so
+    // t[k] = t.at(x) is not one of these cases
+    {
+        Table t;
+        t.setIncrementalRehash(incremental);
+        t.insert("a", big);
+        int wrong = 0;
+        for (int i = 0; i < 2000; ++i) {
+            auto res = t.try_emplace(key(i), t.at("a"));
+            if (!res.second || (*res.first).second != big) wrong++;
+            t.emplace(key(i) + "!", t.at(key(i)));
+            if (t.at(key(i) + "!") != big) wrong++;
+        }
+        ASSERT(wrong == 0, "try_emplace or emplace copied a moved value" << mode);
+    }
+
+    // find and remove with keys that belong to the table's own entries
+    {
+        Table t;
+        t.setIncrementalRehash(incremental);
+        for (int i = 0; i < 2000; ++i) t.insert(key(i), big);
+        // a shrinking bound starts a rehash, then every entry is looked up
+        // and removed by its own key while the migration runs
+        t.setMaxLoadFactor(0.3);
+        t.insert("z", big);
+        int missing = 0;
+        for (int i = 0; i < 2000; ++i) {
+            if (!t.find(t.begin()->first) || !t.remove(t.begin()->first)) missing++;
+        }
+        ASSERT(missing == 0 && t.getSize() == 1, "find or remove of an entry's own key failed" << mode);
+    }
+}
+
+// an entry larger than inlineBytes leaves no inline buffer: the table
+// starts on the heap and its object stays small
+struct Large {
+    char bytes[1024];
+    int id;
+};
+
+static void inline_budget() {
+    HashTable<int, Large> t;
+    ASSERT(sizeof(t) < inlineBytes, "A table of 1 KB values carries " << sizeof(t) << " bytes of inline storage");
+    for (int i = 0; i < 100; ++i) {
+        Large v;
+        v.id = i;
+        t.insert(i, v);
+    }
+    int wrong = 0;
+    for (int i = 0; i < 100; ++i) wrong += t.at(i).id != i;
+    ASSERT(wrong == 0 && t.getSize() == 100, "A table without inline entries is not working");
+    ASSERT(sizeof(HashTable<std::string, std::string>) <= sizeof(HashTable<std::string, std::string, DefaultHash<std::string>,
+               DefaultKeyEqual<std::string>, std::allocator<pair<const std::string, std::string>>, PowerOfTwoPolicy,
+               NoStats, 0>) + inlineBytes, "The inline buffer is larger than inlineBytes");
+}
+
+// begin() and end() go straight into the standard algorithms, in
+// insertion order
+static void standard_algorithms() {
+    Table t;
+    std::vector<std::pair<std::string, std::string>> expected;
+    for (int i = 0; i < 100; ++i) {
+        t.insert(key(i), key(2 * i));
+        expected.emplace_back(key(i), key(2 * i));
+    }
+    std::vector<std::pair<std::string, std::string>> copied(t.begin(), t.end());
+    ASSERT(copied == expected && std::distance(t.begin(), t.end()) == 100,
+           "The iterators do not work with the standard algorithms");
+}
+
+int main() {
+    self_references(false);
+    self_references(true);
+    inline_budget();
+    standard_algorithms();
+    return TrueAsserts == TotalAsserts ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+// Stress test for LockFreeHashTable: readers check every value they see while
+// one writer inserts, updates, removes and grows the table, then the final
+// contents are compared with what the writer did. Configure with
+// -DAED_TSAN=ON to run it under ThreadSanitizer, which fails the test on a
+// data race. Exits with 1 on a bad read.
+#undef NDEBUG
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include "../LockFreeHashTable.h"
+#include "../tester.h"
+
+// values carry their key in the high bits, so a reader can tell a torn or
+// misplaced entry from a legitimate update
+static unsigned long long stamp(int key, unsigned long long version) {
+    return (static_cast<unsigned long long>(key) << 24) | (version & 0xFFFFFF);
+}
+
+static void stress(int keys, int readers, int rounds) {
+    LockFreeHashTable<int, unsigned long long> table(2);
+    std::unordered_map<int, unsigned long long> expected;
+    std::atomic<bool> done(false);
+    std::atomic<int> bad(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::mt19937 rng(r + 1);
+            unsigned long long value;
+            while (!done.load()) {
+                int key = static_cast<int>(rng() % keys);
+                if (table.find(key, value) && (value >> 24) != static_cast<unsigned long long>(key)) bad.fetch_add(1);
+                if (rng() % 64 == 0) {
+                    for (auto& kv : table.getAllElements()) {
+                        if ((kv.second >> 24) != static_cast<unsigned long long>(kv.first)) bad.fetch_add(1);
+                    }
+                }
+            }
+        });
+    }
+
+    std::mt19937 rng(0);
+    for (int i = 0; i < rounds; ++i) {
+        int key = static_cast<int>(rng() % keys);
+        if (rng() % 4 == 0) {
+            table.remove(key);
+            expected.erase(key);
+        } else {
+            table.insert(key, stamp(key, i));
+            expected[key] = stamp(key, i);
+        }
+    }
+    done.store(true);
+    for (auto& t : threads) t.join();
+    ASSERT(bad.load() == 0, "A reader saw an inconsistent entry");
+
+    int wrong = 0;
+    unsigned long long value;
+    for (int key = 0; key < keys; ++key) {
+        auto it = expected.find(key);
+        bool found = table.find(key, value);
+        if (found != (it != expected.end()) || (found && value != it->second)) wrong++;
+    }
+    ASSERT(wrong == 0, "The table does not hold what the writer left");
+    ASSERT(table.getSize() == static_cast<int>(expected.size()), "The function getSize is not working");
+}
+
+int main() {
+    stress(1 << 12, 4, 200000);
+    // few keys keep the chains short and the same entries replaced over and over
+    stress(16, 4, 100000);
+    return TrueAsserts == TotalAsserts ? 0 : 1;
+}
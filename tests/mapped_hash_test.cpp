@@ -0,0 +1,120 @@
+// MappedHashTable: a saved table reopens with the same entries in insertion
+// order, and damaged files throw runtime_error instead of reading outside
+// the mapping: a truncated file, section offsets beyond the file, an
+// insertion order slot beyond the table and a string beyond the blob.
+#undef NDEBUG
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../MappedHashTable.h"
+#include "../tester.h"
+
+// where save() puts these Header fields
+static const size_t CAPACITY = 48;
+static const size_t CTRL_OFFSET = 56;
+static const size_t ENTRIES_OFFSET = 64;
+static const size_t ORDER_OFFSET = 72;
+
+typedef MappedHashTable<std::string, float> Mapped;
+
+static std::vector<char> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+static uint64_t get64(const std::vector<char>& bytes, size_t at) {
+    uint64_t v;
+    std::memcpy(&v, bytes.data() + at, sizeof(v));
+    return v;
+}
+
+template <typename T>
+static void put(std::vector<char>& bytes, size_t at, T v) {
+    std::memcpy(bytes.data() + at, &v, sizeof(v));
+}
+
+// opens path and touches every entry; true if that threw runtime_error
+static bool rejected(const std::string& path) {
+    try {
+        Mapped mapped(path);
+        for (auto it = mapped.begin(); it != mapped.end(); ++it) (*it).first.size();
+        mapped.getAllElements();
+        return false;
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+}
+
+int main() {
+    std::string path = "mapped_hash_test.bin";
+    std::string damaged = "mapped_hash_test_damaged.bin";
+
+    HashTable<std::string, float> table;
+    for (int i = 0; i < 1000; ++i) {
+        // every third key is too long for the entry and goes to the blob
+        std::string key = i % 3 == 0 ? "a key long enough for the blob " + std::to_string(i) : "k" + std::to_string(i);
+        table.insert(key, i * 0.5f);
+    }
+    table.remove("k1");
+    Mapped::save(table, path);
+
+    {
+        Mapped mapped(path);
+        ASSERT(mapped.getSize() == table.getSize(), "The function getSize is not working");
+        ASSERT(mapped.getAllElements() == table.getAllElements(), "The insertion order is not kept");
+        ASSERT(mapped.at("a key long enough for the blob 999") == 499.5f, "The function at is not working");
+        ASSERT(!mapped.find("k1"), "The function find is not working");
+    }
+    const std::vector<char> good = read_file(path);
+
+    std::vector<char> bytes(good.begin(), good.begin() + good.size() / 2);
+    write_file(damaged, bytes);
+    ASSERT(rejected(damaged), "A truncated file was accepted");
+
+    bytes = good;
+    put<uint64_t>(bytes, CTRL_OFFSET, ~0ULL - 8);
+    write_file(damaged, bytes);
+    ASSERT(rejected(damaged), "A control offset beyond the file was accepted");
+
+    bytes = good;
+    put<uint64_t>(bytes, ORDER_OFFSET, get64(good, ENTRIES_OFFSET));
+    write_file(damaged, bytes);
+    ASSERT(rejected(damaged), "Overlapping sections were accepted");
+
+    bytes = good;
+    put<uint32_t>(bytes, get64(good, ORDER_OFFSET) + 4 * 10, 0xFFFFFFF0u);
+    write_file(damaged, bytes);
+    ASSERT(rejected(damaged), "An insertion order slot beyond the table was accepted");
+
+    // the first entry in insertion order has a key in the blob; its offset
+    // follows the entry's hash and the key's size
+    bytes = good;
+    uint32_t first;
+    std::memcpy(&first, good.data() + get64(good, ORDER_OFFSET), sizeof(first));
+    size_t entry_size = (get64(good, ORDER_OFFSET) - get64(good, ENTRIES_OFFSET)) / get64(good, CAPACITY);
+    put<uint64_t>(bytes, get64(good, ENTRIES_OFFSET) + first * entry_size + 16, ~0ULL - 4);
+    write_file(damaged, bytes);
+    ASSERT(rejected(damaged), "A string beyond the blob was accepted");
+    bool lookup_threw = false;
+    try {
+        Mapped mapped(damaged);
+        mapped.find("a key long enough for the blob 0");
+    } catch (const std::runtime_error&) {
+        lookup_threw = true;
+    }
+    ASSERT(lookup_threw, "A lookup read a string beyond the blob");
+
+    std::remove(path.c_str());
+    std::remove(damaged.c_str());
+    return TrueAsserts == TotalAsserts ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// PersistentAVLTree against std::set: every snapshot keeps the contents it
+// had when it was taken while the tree goes on inserting and removing, a
+// copied tree changes independently of the original, and the last version
+// to go away frees every node. A reader thread walks a snapshot while the
+// writer keeps going; configure with -DAED_TSAN=ON to run it under
+// ThreadSanitizer.
+#undef NDEBUG
+#include <iostream>
+#include <atomic>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../PersistentAVL.h"
+#include "../tester.h"
+
+// a key that counts its live copies, so the nodes still allocated can be
+// told from the outside
+struct Key {
+    static std::atomic<long> live;
+    int v;
+    Key(int v) : v(v) { live++; }
+    Key(const Key& other) : v(other.v) { live++; }
+    Key& operator=(const Key& other) = default;
+    ~Key() { live--; }
+    bool operator<(const Key& other) const { return v < other.v; }
+    bool operator==(const Key& other) const { return v == other.v; }
+};
+std::atomic<long> Key::live(0);
+
+std::string to_string(const Key& k) {
+    return std::to_string(k.v);
+}
+
+template <typename Version>
+static std::vector<int> keys_of(const Version& version) {
+    std::vector<int> keys;
+    for (auto it = version.begin(); it != version.end(); ++it) keys.push_back((*it).v);
+    return keys;
+}
+
+static std::vector<int> keys_of(const std::set<int>& set) {
+    return std::vector<int>(set.begin(), set.end());
+}
+
+// find, bounds, successor and predecessor of a version against its set
+static bool answers_like(const AVLSnapshot<Key>& version, const std::set<int>& expected) {
+    if (version.size() != static_cast<int>(expected.size())) return false;
+    if (expected.empty()) return version.height() == -1;
+    if (version.minValue().v != *expected.begin() || version.maxValue().v != *expected.rbegin()) return false;
+    for (int k = -1; k < 1002; k += 7) {
+        if (version.find(k) != (expected.count(k) == 1)) return false;
+        auto above = expected.upper_bound(k);
+        if (above != expected.end() && version.successor(k).v != *above) return false;
+        auto below = expected.lower_bound(k);
+        if (below != expected.begin() && version.predecessor(k).v != *std::prev(below)) return false;
+    }
+    return true;
+}
+
+static void snapshot_isolation() {
+    std::mt19937 rng(5);
+    PersistentAVLTree<Key> tree;
+    std::set<int> current;
+    std::vector<std::pair<AVLSnapshot<Key>, std::set<int>>> versions;
+    int wrong = 0;
+    for (int op = 0; op < 20000; ++op) {
+        int k = static_cast<int>(rng() % 1000);
+        if (rng() % 3 == 0) {
+            tree.remove(k);
+            current.erase(k);
+        } else {
+            tree.insert(k);
+            current.insert(k);
+        }
+        if (op % 500 == 0) versions.emplace_back(tree.snapshot(), current);
+        if (op % 1000 == 999 && keys_of(tree) != keys_of(current)) wrong++;
+    }
+    ASSERT(wrong == 0 && answers_like(tree, current), "The tree does not match the set");
+
+    int changed = 0;
+    for (auto& v : versions) {
+        if (keys_of(v.first) != keys_of(v.second) || !answers_like(v.first, v.second)) changed++;
+    }
+    ASSERT(changed == 0, changed << " of " << versions.size() << " snapshots changed after they were taken");
+
+    // a copy of the tree is another version: changing one leaves the other
+    PersistentAVLTree<Key> copy = tree;
+    std::set<int> copied = current;
+    for (int k = 0; k < 1000; k += 3) {
+        copy.remove(k);
+        copied.erase(k);
+        tree.insert(k);
+        current.insert(k);
+    }
+    ASSERT(keys_of(copy) == keys_of(copied) && keys_of(tree) == keys_of(current),
+           "A copied tree shares changes with the original");
+
+    // every version alive: versions, tree and copy; dropping them in any
+    // order frees the nodes only the dropped ones held
+    versions.erase(versions.begin(), versions.begin() + versions.size() / 2);
+    copy.clear();
+    ASSERT(keys_of(tree) == keys_of(current) && keys_of(versions.back().first) == keys_of(versions.back().second),
+           "Releasing some versions damaged the others");
+}
+
+static void refcount_release() {
+    {
+        PersistentAVLTree<Key> tree;
+        for (int k = 0; k < 5000; ++k) tree.insert(k);
+        for (int k = 0; k < 5000; k += 2) tree.remove(k);
+        // without snapshots insert and remove change nodes in place
+        ASSERT(Key::live == tree.size(), "A tree without snapshots holds " << Key::live << " nodes for "
+               << tree.size() << " keys");
+
+        AVLSnapshot<Key> snap = tree.snapshot();
+        AVLSnapshot<Key> again = snap;
+        for (int k = 0; k < 100; ++k) tree.insert(2 * k);
+        // the new version copies at most one search path per insert
+        ASSERT(Key::live <= snap.size() + 100 * (tree.height() + 2),
+               "100 inserts over a snapshot copied " << Key::live - snap.size() << " nodes");
+        snap = AVLSnapshot<Key>();
+        again = AVLSnapshot<Key>();
+        ASSERT(Key::live == tree.size(), "Releasing the snapshots left " << Key::live - tree.size() << " nodes");
+    }
+    ASSERT(Key::live == 0, "Destroying every version left " << Key::live << " nodes");
+}
+
+// a reader walks an older version while the writer keeps changing the tree
+static void concurrent_reader() {
+    PersistentAVLTree<Key> tree;
+    for (int k = 0; k < 20000; ++k) tree.insert(k);
+    AVLSnapshot<Key> snap = tree.snapshot();
+    std::atomic<int> bad(0);
+    std::thread reader([&bad](AVLSnapshot<Key> version) {
+        for (int round = 0; round < 20; ++round) {
+            int expected = 0;
+            for (auto it = version.begin(); it != version.end(); ++it) {
+                if ((*it).v != expected++) bad++;
+            }
+            if (expected != 20000) bad++;
+        }
+    }, std::move(snap));
+    for (int k = 0; k < 20000; k += 2) tree.remove(k);
+    for (int k = 20000; k < 30000; ++k) tree.insert(k);
+    reader.join();
+    ASSERT(bad == 0, "A snapshot read on another thread changed under the writer");
+}
+
+int main() {
+    snapshot_isolation();
+    refcount_release();
+    concurrent_reader();
+    ASSERT(Key::live == 0, "Some versions were never freed: " << Key::live << " nodes left");
+    return TrueAsserts == TotalAsserts ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+// AVLTree sorted runs: save/load round trips for integer, floating point and
+// string keys through a file and through a pipe, lookups through the sparse
+// index, and damaged runs. Every single-bit flip of a saved run must make
+// load throw, and a run that announces more keys than it holds must throw
+// without building a tree of the announced size.
+#undef NDEBUG
+#include <iostream>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "../AVL.h"
+#include "../tester.h"
+
+// where the writer puts the key count and the header checksum
+static const size_t COUNT_AT = 16;
+static const size_t HEADER_SUM_AT = 24;
+
+template <typename T>
+static std::vector<T> keys_of(AVLTree<T>& tree) {
+    std::vector<T> keys;
+    for (auto it = tree.begin(); it != tree.end(); ++it) keys.push_back(*it);
+    return keys;
+}
+
+// a temporary file, deleted when the fd is closed
+static int temp_file() {
+    FILE* f = std::tmpfile();
+    if (f == nullptr) throw std::runtime_error("Cannot create a temporary file");
+    return dup(fileno(f));
+}
+
+template <typename T>
+static std::string saved(AVLTree<T>& tree, bool index) {
+    int fd = temp_file();
+    tree.save(fd, index);
+    std::string bytes(static_cast<size_t>(lseek(fd, 0, SEEK_END)), '\0');
+    sorted_run::pread_all(fd, &bytes[0], bytes.size(), 0);
+    close(fd);
+    return bytes;
+}
+
+static int file_with(const std::string& bytes) {
+    int fd = temp_file();
+    sorted_run::write_all(fd, bytes.data(), bytes.size());
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+// load from a regular file; the message of the error, or "" if it loaded
+template <typename T>
+static std::string load_file(const std::string& bytes, std::vector<T>* keys = nullptr) {
+    int fd = file_with(bytes);
+    try {
+        AVLTree<T> tree = AVLTree<T>::load(fd);
+        if (keys) *keys = keys_of(tree);
+    } catch (const std::runtime_error& e) {
+        close(fd);
+        return e.what();
+    }
+    close(fd);
+    return "";
+}
+
+// load from a pipe fed by another thread, so no file size is known
+template <typename T>
+static std::string load_pipe(const std::string& bytes, std::vector<T>* keys = nullptr) {
+    int fds[2];
+    if (pipe(fds) != 0) throw std::runtime_error("Cannot create a pipe");
+    std::thread writer([&] {
+        try {
+            sorted_run::write_all(fds[1], bytes.data(), bytes.size());
+        } catch (const std::runtime_error&) {
+            // the reader stopped early and closed its end
+        }
+        close(fds[1]);
+    });
+    std::string error;
+    try {
+        AVLTree<T> tree = AVLTree<T>::load(fds[0]);
+        if (keys) *keys = keys_of(tree);
+    } catch (const std::runtime_error& e) {
+        error = e.what();
+    }
+    close(fds[0]);
+    writer.join();
+    return error;
+}
+
+template <typename T>
+static void round_trip(const std::vector<T>& keys, const char* type) {
+    AVLTree<T> tree;
+    for (const T& k : keys) tree.insert(k);
+    std::vector<T> expected = keys_of(tree);
+    for (bool index : {false, true}) {
+        std::string bytes = saved(tree, index);
+        std::vector<T> from_file, from_pipe;
+        ASSERT(load_file(bytes, &from_file).empty() && from_file == expected,
+               "A sorted run of " << type << " keys does not load back from a file");
+        ASSERT(load_pipe(bytes, &from_pipe).empty() && from_pipe == expected,
+               "A sorted run of " << type << " keys does not load back from a pipe");
+    }
+    AVLTree<T> empty;
+    std::vector<T> none(1);
+    ASSERT(load_pipe(saved(empty, false), &none).empty() && none.empty(),
+           "An empty sorted run of " << type << " keys does not load back");
+}
+
+template <typename T>
+static std::vector<T> random_keys(int n, unsigned seed, T (*make)(std::mt19937_64&)) {
+    std::mt19937_64 rng(seed);
+    std::vector<T> keys(n);
+    for (T& k : keys) k = make(rng);
+    return keys;
+}
+
+static std::string make_string(std::mt19937_64& rng) {
+    // shared prefixes, and some keys long enough to leave the inline buffer
+    static const char* const prefixes[] = {"", "user:", "user:eu-west/", "/tenants/acme-corporation/users/"};
+    return prefixes[rng() % 4] + std::to_string(rng() % 100000);
+}
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// rewrites the key count of a run and, if fix_sum, its header checksum too
+static std::string with_count(std::string bytes, uint64_t count, bool fix_sum) {
+    for (int i = 0; i < 8; ++i) bytes[COUNT_AT + i] = static_cast<char>(count >> (8 * i));
+    if (fix_sum) {
+        uint32_t sum = sorted_run::checksum(bytes.data(), HEADER_SUM_AT);
+        for (int i = 0; i < 4; ++i) bytes[HEADER_SUM_AT + i] = static_cast<char>(sum >> (8 * i));
+    }
+    return bytes;
+}
+
+int main() {
+    // a load that stops early closes the pipe under its writer
+    std::signal(SIGPIPE, SIG_IGN);
+
+    round_trip<int>(random_keys<int>(50000, 1, [](std::mt19937_64& r) { return static_cast<int>(r()); }), "int");
+    round_trip<long long>(random_keys<long long>(50000, 2, [](std::mt19937_64& r) {
+        return static_cast<long long>(r());
+    }), "long long");
+    round_trip<long long>({LLONG_MIN, -1, 0, 1, LLONG_MAX}, "extreme long long");
+    round_trip<unsigned>(random_keys<unsigned>(50000, 3, [](std::mt19937_64& r) {
+        return static_cast<unsigned>(r());
+    }), "unsigned");
+    round_trip<unsigned>({0u, 1u, 0x7FFFFFFFu, 0x80000000u, UINT_MAX}, "extreme unsigned");
+    round_trip<double>(random_keys<double>(20000, 4, [](std::mt19937_64& r) {
+        return (static_cast<double>(r() % 2000000) - 1000000) / 7;
+    }), "double");
+    round_trip<std::string>(random_keys<std::string>(20000, 5, make_string), "string");
+
+    // index lookups: every saved key is found, and keys between, below and
+    // above them are not
+    {
+        AVLTree<int> tree;
+        for (int k = 0; k < 200000; k += 2) tree.insert(k);
+        int fd = file_with(saved(tree, true));
+        int wrong = 0;
+        for (int k = -3; k < 200003; k += 7) {
+            if (sorted_run_contains(fd, k) != (k >= 0 && k < 200000 && k % 2 == 0)) wrong++;
+        }
+        close(fd);
+        ASSERT(wrong == 0, "The function sorted_run_contains is not working");
+    }
+    {
+        AVLTree<std::string> tree;
+        for (int k = 0; k < 20000; ++k) tree.insert("key:" + std::to_string(k));
+        int fd = file_with(saved(tree, true));
+        ASSERT(sorted_run_contains(fd, std::string("key:12345")) && !sorted_run_contains(fd, std::string("key:1234x"))
+               && !sorted_run_contains(fd, std::string("a")) && !sorted_run_contains(fd, std::string("z")),
+               "The function sorted_run_contains is not working for strings");
+        close(fd);
+    }
+
+    AVLTree<int> tree;
+    for (int k = 0; k < 100000; ++k) tree.insert(k * 3);
+    const std::string good = saved(tree, false);
+
+    // single-bit flips anywhere in the run, the header included
+    {
+        std::mt19937 rng(7);
+        int missed = 0;
+        for (int i = 0; i < 200; ++i) {
+            std::string bytes = good;
+            // the first flips cover every header byte
+            size_t at = i < static_cast<int>(sorted_run::HeaderBytes) ? i : rng() % bytes.size();
+            bytes[at] ^= static_cast<char>(1 << (rng() % 8));
+            if (load_file<int>(bytes).empty()) missed++;
+        }
+        ASSERT(missed == 0, missed << " of 200 single-bit flips loaded without an error");
+    }
+
+    // a flip in the key count (byte 19) used to build a tree of the new count
+    // before noticing the run was short of keys
+    long before = peak_rss_kb();
+    {
+        std::string bytes = good;
+        bytes[19] ^= 0x40;
+        ASSERT(load_file<int>(bytes).find("header checksum") != std::string::npos,
+               "A key count flip is not caught by the header checksum");
+        ASSERT(load_pipe<int>(bytes).find("header checksum") != std::string::npos,
+               "A key count flip is not caught by the header checksum in a pipe");
+    }
+    // an inflated count with a matching checksum: a file is rejected by its
+    // size, a pipe stops building at the end of the real keys
+    {
+        std::string bytes = with_count(good, 1u << 30, true);
+        ASSERT(load_file<int>(bytes).find("more keys than the file") != std::string::npos,
+               "A key count larger than the file is accepted");
+        ASSERT(load_pipe<int>(bytes).find("fewer keys") != std::string::npos,
+               "A key count larger than the run is accepted from a pipe");
+        ASSERT(load_file<int>(with_count(good, 99999, true)).find("more keys than the header") != std::string::npos,
+               "A key count smaller than the run is accepted");
+    }
+    ASSERT(peak_rss_kb() - before < 64 * 1024, "Loading a damaged run grew memory by "
+           << (peak_rss_kb() - before) / 1024 << " MB");
+
+    return TrueAsserts == TotalAsserts ? 0 : 1;
+}